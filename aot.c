@@ -0,0 +1,80 @@
+#include <stdlib.h>
+#include <string.h>
+#include "aot.h"
+#include "profile.h"
+#include "quirks.h"
+
+AOTCache *CreateAOTCache(const AOTProgram *program)
+{
+    AOTCache *aot;
+    int addr, quirks;
+
+    if(program == NULL || (aot = calloc(1, sizeof(AOTCache))) == NULL)
+        return NULL;
+
+    aot->program = program;
+    for(quirks = 0; quirks < QUIRK_PROFILES; ++quirks)
+    {
+        for(addr = 0; addr < MEMORY_SIZE; ++addr)
+        {
+            if(program->blocks[quirks][addr].code != NULL)
+                memset(&aot->codeMap[addr], 1, 2 * program->blocks[quirks][addr].count);
+        }
+    }
+
+    return aot;
+}
+
+void DestroyAOTCache(AOTCache *aot)
+{
+    free(aot);
+}
+
+void InvalidateAOT(AOTCache *aot, WORD addr)
+{
+    // Self-modifying code is rare, so rechecking everything keeps this simple
+    if(aot->codeMap[addr & ADDRESS_MASK])
+        memset(aot->checked, AOT_UNCHECKED, sizeof(aot->checked));
+}
+
+void RunCyclesAOT(CHIP8 *cpu, unsigned long count)
+{
+    AOTCache *aot = cpu->aotCache;
+    const AOTProgram *program = aot->program;
+    const AOTBlock *blocks = program->blocks[cpu->quirks];
+    DecodeFunction decode = SelectDecodeExecute(cpu->quirks);
+
+    while(count > 0)
+    {
+        WORD pc = cpu->PC;
+        const AOTBlock *block = &blocks[pc];
+
+        // The machine may be running another ROM, or code written since it
+        // was translated. Compare once, then trust the result until a store
+        if(block->code != NULL && aot->checked[pc] == AOT_UNCHECKED)
+            aot->checked[pc] = memcmp(&cpu->mainMemory[pc], &program->image[pc], 2 * block->count) == 0 ?
+                               AOT_MATCHES : AOT_DIFFERS;
+
+        // Blocks that would overrun the budget are interpreted one step at a time
+        if(aot->checked[pc] == AOT_MATCHES && block->count <= count)
+        {
+            PROFILE_BLOCK(cpu, pc, block->count);
+            block->code(cpu);
+            count -= block->count;
+
+            // Only the last instruction of a block can branch. Moving back to or
+            // before it may have closed a busy-wait loop
+            if(cpu->PC <= pc + 2 * (block->count - 1))
+                count -= IdleSkip(cpu, count);
+        }
+        else
+        {
+            PROFILE_INSTRUCTION(cpu, pc);
+            decode(cpu, Fetch(cpu));
+            --count;
+
+            if(cpu->PC <= pc)
+                count -= IdleSkip(cpu, count);
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef AOT_H
+#define AOT_H
+
+#include "chip8core.h"
+
+// One basic block translated ahead of time by chip8-translate. Running it leaves
+// the machine exactly where DecodeExecute would after count instructions
+typedef struct AOTBlock
+{
+    void (*code)(CHIP8 *cpu);   // NULL if no block starts at the address
+    WORD count;                 // Instructions the block executes
+} AOTBlock;
+
+// A whole translated ROM, as emitted into a C file by chip8-translate. Blocks
+// are indexed by quirk profile, and those with quirk-dependent instructions
+// have one copy per profile. image is memory as it was translated, and a
+// block is only run while the bytes it covers still match it
+typedef struct AOTProgram
+{
+    AOTBlock blocks[QUIRK_PROFILES][MEMORY_SIZE];
+    BYTE image[MEMORY_SIZE];
+} AOTProgram;
+
+// Per-machine state for ENGINE_AOT. Blocks are checked against the live memory
+// the first time they run, and again after any store to translated code
+typedef struct AOTCache
+{
+    const AOTProgram *program;
+    BYTE codeMap[MEMORY_SIZE];  // Non-zero for bytes covered by some block
+    BYTE checked[MEMORY_SIZE];  // AOT_UNCHECKED, AOT_MATCHES or AOT_DIFFERS per block
+} AOTCache;
+
+enum { AOT_UNCHECKED, AOT_MATCHES, AOT_DIFFERS };
+
+AOTCache *CreateAOTCache(const AOTProgram *program);
+void DestroyAOTCache(AOTCache *aot);
+
+// Recheck every block if the byte at addr was translated
+void InvalidateAOT(AOTCache *aot, WORD addr);
+
+// Execute count instructions, running translated blocks where they still match
+// memory and interpreting everything else
+void RunCyclesAOT(CHIP8 *cpu, unsigned long count);
+
+#endif
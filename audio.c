@@ -0,0 +1,79 @@
+#include <string.h>
+#include "audio.h"
+
+// SDL calls this whenever the device needs more samples. Plays whatever tone is
+// left, then silence
+static void FillAudio(void *userdata, Uint8 *stream, int length)
+{
+    Audio *audio = userdata;
+    Sint16 *samples = (Sint16 *)stream;
+    int count = length / (int)sizeof(Sint16);
+    int remaining, tone, i;
+
+    // The frontend may reset the count at any moment. Take samples from
+    // whichever value is current
+    do
+    {
+        remaining = SDL_AtomicGet(&audio->remaining);
+        tone = remaining < count ? remaining : count;
+    } while(tone > 0 && !SDL_AtomicCAS(&audio->remaining, remaining, remaining - tone));
+
+    for(i = 0; i < tone; ++i)
+    {
+        samples[i] = audio->phase < audio->halfPeriod ? AUDIO_VOLUME : -AUDIO_VOLUME;
+        if(++audio->phase == 2 * audio->halfPeriod)
+            audio->phase = 0;
+    }
+    for(; i < count; ++i)
+        samples[i] = 0;
+}
+
+int OpenAudio(Audio *audio, unsigned int bufferSamples)
+{
+    SDL_AudioSpec want, have;
+
+    memset(&want, 0, sizeof(want));
+    want.freq = AUDIO_SAMPLE_RATE;
+    want.format = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples = bufferSamples;
+    want.callback = FillAudio;
+    want.userdata = audio;
+
+    SDL_AtomicSet(&audio->remaining, 0);
+    audio->soundTimer = 0;
+    audio->phase = 0;
+
+    // Take whatever rate the hardware prefers rather than resampling
+    audio->device = SDL_OpenAudioDevice(NULL, 0, &want, &have, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+    if(audio->device == 0)
+        return -1;
+
+    audio->samplesPerTick = have.freq / TIMER_HZ;
+    audio->halfPeriod = have.freq / AUDIO_TONE_HZ / 2;
+    SDL_PauseAudioDevice(audio->device, 0);
+
+    return 0;
+}
+
+void CloseAudio(Audio *audio)
+{
+    if(audio->device != 0)
+        SDL_CloseAudioDevice(audio->device);
+    audio->device = 0;
+}
+
+void UpdateAudio(Audio *audio, BYTE soundTimer)
+{
+    BYTE expected = audio->soundTimer > 0 ? audio->soundTimer - 1 : 0;
+
+    if(audio->device == 0)
+        return;
+
+    // A timer that just ticked down is already covered by the samples queued
+    // when it was set, so the tone ends exactly when the timer runs out. Only a
+    // new value from the program, a load or a rewind restarts the count
+    if(soundTimer != expected)
+        SDL_AtomicSet(&audio->remaining, soundTimer * audio->samplesPerTick);
+    audio->soundTimer = soundTimer;
+}
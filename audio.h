@@ -0,0 +1,40 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <SDL2/SDL.h>
+#include "chip8core.h"
+
+// The beep is a square wave synthesized on SDL's audio thread, so nothing is
+// loaded at startup and the tone starts and stops at sample granularity
+#define AUDIO_SAMPLE_RATE 44100
+#define AUDIO_TONE_HZ 440
+#define AUDIO_VOLUME 3000
+
+// Samples per callback. 512 at 44.1 kHz is under 12 ms of latency
+#define DEFAULT_AUDIO_BUFFER 512
+
+typedef struct Audio
+{
+    SDL_AudioDeviceID device;   // Zero when there is nothing to play to
+    int samplesPerTick;         // Samples in one 60Hz timer tick at the device rate
+
+    // Samples of tone left to play. The frontend sets it from the sound timer,
+    // the audio thread counts it down as it plays
+    SDL_atomic_t remaining;
+    BYTE soundTimer;            // Sound timer as of the last UpdateAudio
+
+    // Only touched by the audio thread once the device is running
+    unsigned int halfPeriod;    // Samples per half cycle of the tone
+    unsigned int phase;
+} Audio;
+
+// Open the default output with bufferSamples per callback. On failure audio is
+// a null sink that UpdateAudio and CloseAudio accept, and non-zero is returned.
+// Headless runs never open one
+int OpenAudio(Audio *audio, unsigned int bufferSamples);
+void CloseAudio(Audio *audio);
+
+// Call once per frame after the timers tick, with the sound timer's new value
+void UpdateAudio(Audio *audio, BYTE soundTimer);
+
+#endif
@@ -0,0 +1,431 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "chip8core.h"
+#include "headless.h"
+#include "catalog.h"
+#include "movie.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// Longest manifest line
+#define MAX_LINE 1024
+
+// One run from the manifest and, once it has run, its outcome
+typedef struct Job
+{
+    char romPath[MAX_LINE];
+    char moviePath[MAX_LINE];   // Empty unless the run replays a movie
+    uint64_t seed;
+    QuirkProfile quirks;
+    HeadlessOptions limits;
+
+    const char *status;         // "ok", "diverged" or what went wrong
+    unsigned long cycles;
+    uint64_t screenHash;
+    double seconds;
+} Job;
+
+// Each worker owns a range of jobs. It takes from the front of its own range and,
+// once that is empty, steals the back half of someone else's
+typedef struct Worker
+{
+    pthread_t thread;
+    pthread_mutex_t lock;
+    size_t next;
+    size_t end;
+
+    struct Batch *batch;
+    CHIP8 *cpu;                 // Reused for every job the worker runs
+} Worker;
+
+typedef struct Batch
+{
+    Job *jobs;
+    size_t count;
+    Engine engine;
+
+    Worker *workers;
+    int threads;
+} Batch;
+
+// Seconds on a monotonic clock
+static double Now(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (double)counter.QuadPart / frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+static int CountProcessors(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? count : 1;
+#endif
+}
+
+// Parse one manifest line of the form
+//   <rom-file> [frames=<n>] [cycles=<n>] [ipf=<n>] [seed=<n>] [quirks=<profile>] [movie=<file>]
+// Returns non-zero if it is malformed
+static int ParseJob(char *line, Job *job)
+{
+    char *token = strtok(line, " \t\r\n");
+
+    memset(job, 0, sizeof(Job));
+    job->limits.cyclesPerFrame = CYCLES_PER_FRAME;
+    strncpy(job->romPath, token, MAX_LINE - 1);
+
+    while((token = strtok(NULL, " \t\r\n")) != NULL)
+    {
+        if(strncmp(token, "frames=", 7) == 0)
+            job->limits.maxFrames = strtoul(token + 7, NULL, 0);
+        else if(strncmp(token, "cycles=", 7) == 0)
+            job->limits.maxCycles = strtoul(token + 7, NULL, 0);
+        else if(strncmp(token, "ipf=", 4) == 0)
+            job->limits.cyclesPerFrame = strtoul(token + 4, NULL, 0);
+        else if(strncmp(token, "seed=", 5) == 0)
+            job->seed = strtoull(token + 5, NULL, 0);
+        else if(strncmp(token, "quirks=", 7) == 0)
+        {
+            int quirks = FindQuirkProfile(token + 7);
+            if(quirks < 0)
+                return -1;
+            job->quirks = quirks;
+        }
+        else if(strncmp(token, "movie=", 6) == 0)
+            strncpy(job->moviePath, token + 6, MAX_LINE - 1);
+        else
+            return -1;
+    }
+
+    // Movies know their own length, anything else needs a budget
+    if(job->limits.cyclesPerFrame == 0)
+        return -1;
+    if(job->moviePath[0] == '\0' && job->limits.maxFrames == 0 && job->limits.maxCycles == 0)
+        return -1;
+    return 0;
+}
+
+// Read the manifest. Blank lines and lines starting with '#' are skipped
+static int ReadManifest(const char *path, Batch *batch)
+{
+    char line[MAX_LINE];
+    size_t capacity = 0;
+    unsigned long number = 0;
+    FILE *input;
+
+    if((input = fopen(path, "r")) == NULL)
+    {
+        fprintf(stderr, "FILE I/O ERROR!\nCould not open file \"%s\".", path);
+        return -1;
+    }
+
+    while(fgets(line, sizeof(line), input) != NULL)
+    {
+        char *start = line + strspn(line, " \t\r\n");
+
+        // A line that doesn't fit would be read as two, the second a bogus job.
+        // Only the last line of a file may end without a newline
+        ++number;
+        if(strchr(line, '\n') == NULL && !feof(input) && fgetc(input) != EOF)
+        {
+            fprintf(stderr, "MANIFEST ERROR!\nLine %lu of \"%s\" is malformed.", number, path);
+            fclose(input);
+            return -1;
+        }
+        if(*start == '\0' || *start == '#')
+            continue;
+
+        if(batch->count == capacity)
+        {
+            Job *jobs;
+            capacity = capacity > 0 ? capacity * 2 : 64;
+            if((jobs = realloc(batch->jobs, capacity * sizeof(Job))) == NULL)
+            {
+                fprintf(stderr, "MEMORY ERROR!\nCould not hold the manifest.");
+                fclose(input);
+                return -1;
+            }
+            batch->jobs = jobs;
+        }
+
+        if(ParseJob(start, &batch->jobs[batch->count]) != 0)
+        {
+            fprintf(stderr, "MANIFEST ERROR!\nLine %lu of \"%s\" is malformed.", number, path);
+            fclose(input);
+            return -1;
+        }
+        ++batch->count;
+    }
+
+    fclose(input);
+    return 0;
+}
+
+// Boot the worker's machine with the job's ROM and run it
+static void RunJob(Worker *worker, Job *job)
+{
+    CHIP8 *cpu = worker->cpu;
+    Movie movie;
+    size_t size;
+    double start = Now();
+
+    memset(cpu, 0, sizeof(CHIP8));
+    if(ReadROMFile(job->romPath, &cpu->mainMemory[PROGRAM_START], MAX_ROM_SIZE, &size) != 0)
+    {
+        job->status = "rom not readable or too large";
+        return;
+    }
+
+    InitializeCPU(cpu);
+    cpu->quirks = job->quirks;
+    if(SetEngine(cpu, worker->batch->engine) != 0)
+    {
+        job->status = "engine unavailable";
+        return;
+    }
+
+    if(job->moviePath[0] != '\0')
+    {
+        if(LoadMovie(&movie, job->moviePath) != 0)
+        {
+            job->status = "movie not loaded";
+            ReleaseEngine(cpu);
+            return;
+        }
+
+        // A movie brings its own quirks, unless it is older than them
+        SeedRandom(cpu, movie.seed);
+        if(movie.quirks >= 0)
+            cpu->quirks = movie.quirks;
+        job->status = ReplayMovie(cpu, &movie) == movie.screenHash ? "ok" : "diverged";
+        job->cycles = movie.frames * movie.cyclesPerFrame;
+        FreeMovie(&movie);
+    }
+    else
+    {
+        SeedRandom(cpu, job->seed);
+        job->cycles = RunHeadless(cpu, &job->limits);
+        job->status = "ok";
+    }
+
+    job->screenHash = HashScreen(SCREEN_HASH_BASIS, cpu);
+    job->seconds = Now() - start;
+    ReleaseEngine(cpu);
+}
+
+static int TakeJob(Worker *worker, size_t *job)
+{
+    int found;
+
+    pthread_mutex_lock(&worker->lock);
+    found = worker->next < worker->end;
+    if(found)
+        *job = worker->next++;
+    pthread_mutex_unlock(&worker->lock);
+
+    return found;
+}
+
+// Move the back half of the first non-empty range found into the thief's own.
+// Only one lock is ever held at a time. Returns zero once every range is empty
+static int StealJobs(Worker *thief)
+{
+    Batch *batch = thief->batch;
+    int i;
+
+    for(i = 1; i < batch->threads; ++i)
+    {
+        Worker *victim = &batch->workers[(thief - batch->workers + i) % batch->threads];
+        size_t begin = 0, end = 0;
+
+        pthread_mutex_lock(&victim->lock);
+        if(victim->next < victim->end)
+        {
+            end = victim->end;
+            begin = end - (end - victim->next + 1) / 2;
+            victim->end = begin;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if(begin < end)
+        {
+            pthread_mutex_lock(&thief->lock);
+            thief->next = begin;
+            thief->end = end;
+            pthread_mutex_unlock(&thief->lock);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void *WorkerMain(void *argument)
+{
+    Worker *worker = argument;
+    size_t job;
+
+    do
+    {
+        while(TakeJob(worker, &job))
+            RunJob(worker, &worker->batch->jobs[job]);
+    } while(StealJobs(worker));
+
+    return NULL;
+}
+
+// Results in manifest order, as a JSON array
+static int WriteResults(const Batch *batch, const char *path, double seconds)
+{
+    FILE *output;
+    size_t i;
+
+    if((output = fopen(path, "w")) == NULL)
+    {
+        fprintf(stderr, "FILE I/O ERROR!\nCould not open file \"%s\".", path);
+        return -1;
+    }
+
+    fprintf(output, "{\n  \"threads\": %d,\n  \"seconds\": %.6f,\n  \"runs\": [\n", batch->threads, seconds);
+    for(i = 0; i < batch->count; ++i)
+    {
+        const Job *job = &batch->jobs[i];
+
+        fprintf(output, "    { \"rom\": ");
+        WriteJSONString(job->romPath, output);
+        fprintf(output, ", \"status\": \"%s\", \"cycles\": %lu, "
+                "\"screen_hash\": \"%016llx\", \"seconds\": %.6f }%s\n",
+                job->status, job->cycles, (unsigned long long)job->screenHash,
+                job->seconds, i + 1 < batch->count ? "," : "");
+    }
+    fprintf(output, "  ]\n}\n");
+
+    return fclose(output) != 0 ? -1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    Batch batch = {0};
+    const char *paths[2];
+    int positional = 0;
+    int failed = 0;
+    double start;
+    size_t i;
+    int t;
+
+    batch.engine = ENGINE_CACHED;
+    batch.threads = CountProcessors();
+
+    for(t = 1; t < argc; ++t)
+    {
+        if(strcmp(argv[t], "--threads") == 0 && t + 1 < argc)
+            batch.threads = atoi(argv[++t]);
+        else if(strcmp(argv[t], "--engine") == 0 && t + 1 < argc)
+        {
+            ++t;
+            if(strcmp(argv[t], "switch") == 0)
+                batch.engine = ENGINE_SWITCH;
+            else if(strcmp(argv[t], "cached") == 0)
+                batch.engine = ENGINE_CACHED;
+            else if(strcmp(argv[t], "jit") == 0)
+                batch.engine = ENGINE_JIT;
+            // No aot. Translated code is built into an emulator for one ROM
+            // (make aot), while a batch runs whatever ROMs its manifest names
+            else
+                positional = -1;
+        }
+        else if(positional >= 0 && positional < 2 && argv[t][0] != '-')
+            paths[positional++] = argv[t];
+        else
+            positional = -1;
+    }
+
+    if(positional != 2 || batch.threads <= 0)
+    {
+        fprintf(stderr, "USAGE ERROR!\nCorrect Usage: chip8-batch [--threads <n>] [--engine switch|cached|jit] <manifest> <results-file>.");
+        return -1;
+    }
+
+    if(ReadManifest(paths[0], &batch) != 0)
+        return -1;
+
+    // No point in idle threads
+    if((size_t)batch.threads > batch.count)
+        batch.threads = batch.count > 0 ? batch.count : 1;
+
+    batch.workers = calloc(batch.threads, sizeof(Worker));
+    if(batch.workers == NULL)
+    {
+        fprintf(stderr, "MEMORY ERROR!\nCould not create the workers.");
+        return -1;
+    }
+
+    // Deal the jobs out in equal contiguous ranges to start with
+    for(t = 0; t < batch.threads; ++t)
+    {
+        Worker *worker = &batch.workers[t];
+
+        worker->batch = &batch;
+        worker->next = batch.count * t / batch.threads;
+        worker->end = batch.count * (t + 1) / batch.threads;
+        worker->cpu = malloc(sizeof(CHIP8));
+        pthread_mutex_init(&worker->lock, NULL);
+        if(worker->cpu == NULL)
+        {
+            fprintf(stderr, "MEMORY ERROR!\nCould not create the workers.");
+            return -1;
+        }
+    }
+
+    start = Now();
+    for(t = 0; t < batch.threads; ++t)
+    {
+        if(pthread_create(&batch.workers[t].thread, NULL, WorkerMain, &batch.workers[t]) != 0)
+        {
+            fprintf(stderr, "THREAD ERROR!\nCould not start worker %d.", t);
+            return -1;
+        }
+    }
+    for(t = 0; t < batch.threads; ++t)
+        pthread_join(batch.workers[t].thread, NULL);
+
+    if(WriteResults(&batch, paths[1], Now() - start) != 0)
+        return -1;
+
+    for(i = 0; i < batch.count; ++i)
+    {
+        if(strcmp(batch.jobs[i].status, "ok") != 0)
+            ++failed;
+    }
+    fprintf(stderr, "%lu runs on %d threads in %.3f s, %d failed\n",
+            (unsigned long)batch.count, batch.threads, Now() - start, failed);
+
+    for(t = 0; t < batch.threads; ++t)
+    {
+        pthread_mutex_destroy(&batch.workers[t].lock);
+        free(batch.workers[t].cpu);
+    }
+    free(batch.workers);
+    free(batch.jobs);
+
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chip8core.h"
+#include "headless.h"
+#include "lockstep.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+// Seconds on a monotonic clock
+static double Now(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (double)counter.QuadPart / frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+// Wrappers give every handler the same shape
+static void Bench00E0(CHIP8 *cpu, WORD inst) { Execute00E0(cpu); }
+static void Bench00EE(CHIP8 *cpu, WORD inst) { Execute00EE(cpu); }
+static void Bench00FB(CHIP8 *cpu, WORD inst) { Execute00FB(cpu); }
+static void Bench00FC(CHIP8 *cpu, WORD inst) { Execute00FC(cpu); }
+static void Bench00FD(CHIP8 *cpu, WORD inst) { Execute00FD(cpu); }
+static void Bench00FE(CHIP8 *cpu, WORD inst) { Execute00FE(cpu); }
+static void Bench00FF(CHIP8 *cpu, WORD inst) { Execute00FF(cpu); }
+
+// Put the machine back in a state where the handler does its full work. Runs
+// before every call, and its cost is measured separately and subtracted
+static void PrepareNothing(CHIP8 *cpu) { }
+static void PrepareStack(CHIP8 *cpu) { cpu->SP = STACK_START; }
+static void PrepareReturn(CHIP8 *cpu) { cpu->SP = STACK_START + 2; }
+static void PrepareMemory(CHIP8 *cpu) { cpu->regI = 0x300; }
+static void PrepareSprite(CHIP8 *cpu) { cpu->regI = 0x000; }
+static void PrepareHires(CHIP8 *cpu) { cpu->hires = 1; cpu->regI = 0x000; }
+
+typedef struct OpcodeBench
+{
+    const char *name;
+    void (*execute)(CHIP8 *cpu, WORD inst);
+    WORD inst;
+    void (*prepare)(CHIP8 *cpu);
+} OpcodeBench;
+
+static const OpcodeBench OPCODES[] =
+{
+    { "00E0", Bench00E0,   0x00E0, PrepareNothing },
+    { "00EE", Bench00EE,   0x00EE, PrepareReturn },
+    { "00CN", Execute00CN, 0x00C4, PrepareHires },
+    { "00FB", Bench00FB,   0x00FB, PrepareHires },
+    { "00FC", Bench00FC,   0x00FC, PrepareHires },
+    { "00FD", Bench00FD,   0x00FD, PrepareNothing },
+    { "00FE", Bench00FE,   0x00FE, PrepareNothing },
+    { "00FF", Bench00FF,   0x00FF, PrepareNothing },
+    { "0NNN", Execute0NNN, 0x0123, PrepareNothing },
+    { "1NNN", Execute1NNN, 0x1200, PrepareNothing },
+    { "2NNN", Execute2NNN, 0x2200, PrepareStack },
+    { "3XNN", Execute3XNN, 0x3105, PrepareNothing },
+    { "4XNN", Execute4XNN, 0x4105, PrepareNothing },
+    { "5XY0", Execute5XY0, 0x5120, PrepareNothing },
+    { "6XNN", Execute6XNN, 0x6142, PrepareNothing },
+    { "7XNN", Execute7XNN, 0x7103, PrepareNothing },
+    { "8XY0", Execute8XY0, 0x8120, PrepareNothing },
+    { "8XY1", Execute8XY1, 0x8121, PrepareNothing },
+    { "8XY2", Execute8XY2, 0x8122, PrepareNothing },
+    { "8XY3", Execute8XY3, 0x8123, PrepareNothing },
+    { "8XY4", Execute8XY4, 0x8124, PrepareNothing },
+    { "8XY5", Execute8XY5, 0x8125, PrepareNothing },
+    { "8XY6", Execute8XY6, 0x8126, PrepareNothing },
+    { "8XY7", Execute8XY7, 0x8127, PrepareNothing },
+    { "8XYE", Execute8XYE, 0x812E, PrepareNothing },
+    { "9XY0", Execute9XY0, 0x9120, PrepareNothing },
+    { "ANNN", ExecuteANNN, 0xA300, PrepareNothing },
+    { "BNNN", ExecuteBNNN, 0xB200, PrepareNothing },
+    { "CXNN", ExecuteCXNN, 0xC1FF, PrepareNothing },
+    { "DXYN", ExecuteDXYN, 0xD125, PrepareSprite },
+    { "DXY0", ExecuteDXYN, 0xD120, PrepareHires },
+    { "EX9E", ExecuteEX9E, 0xE39E, PrepareNothing },
+    { "EXA1", ExecuteEXA1, 0xE3A1, PrepareNothing },
+    { "FX07", ExecuteFX07, 0xF107, PrepareNothing },
+    { "FX0A", ExecuteFX0A, 0xF10A, PrepareNothing },
+    { "FX15", ExecuteFX15, 0xF115, PrepareNothing },
+    { "FX18", ExecuteFX18, 0xF118, PrepareNothing },
+    { "FX1E", ExecuteFX1E, 0xF31E, PrepareMemory },
+    { "FX29", ExecuteFX29, 0xF129, PrepareNothing },
+    { "FX30", ExecuteFX30, 0xF130, PrepareNothing },
+    { "FX33", ExecuteFX33, 0xF133, PrepareMemory },
+    { "FX55", ExecuteFX55, 0xFF55, PrepareMemory },
+    { "FX65", ExecuteFX65, 0xFF65, PrepareMemory },
+    { "FX75", ExecuteFX75, 0xFF75, PrepareNothing },
+    { "FX85", ExecuteFX85, 0xFF85, PrepareNothing },
+};
+
+// Synthetic workloads. Each is an endless loop so any cycle budget can be run
+static const BYTE ROM_ALU[] =
+{
+    0x60, 0x01, 0x61, 0x02, 0x80, 0x14, 0x81, 0x05, 0x72, 0x01, 0x83, 0x20, 0x84, 0x32,
+    0x85, 0x43, 0x86, 0x51, 0x80, 0x67, 0x3F, 0x00, 0x65, 0x07, 0x94, 0x50, 0x12, 0x00
+};
+static const BYTE ROM_DRAW[] =
+{
+    0x00, 0xE0, 0xA0, 0x00, 0xD0, 0x15, 0x70, 0x05, 0xD0, 0x15, 0x71, 0x03, 0xD0, 0x1F,
+    0xD1, 0x05, 0xA0, 0x28, 0xD0, 0x15, 0x12, 0x02
+};
+static const BYTE ROM_CALL[] =
+{
+    0x22, 0x08, 0x22, 0x0C, 0x12, 0x00, 0x00, 0x00,
+    0x70, 0x01, 0x22, 0x0C, 0x00, 0xEE, 0x00, 0x00,
+};
+static const BYTE ROM_MEMORY[] =
+{
+    0xA3, 0x00, 0xFF, 0x55, 0xA3, 0x10, 0xFF, 0x65, 0xF0, 0x33, 0xA3, 0x20, 0xF7, 0x55,
+    0xA3, 0x03, 0xF7, 0x65, 0x70, 0x01, 0x12, 0x00
+};
+
+typedef struct RomBench
+{
+    const char *name;
+    const BYTE *rom;
+    size_t size;
+} RomBench;
+
+static const RomBench ROMS[] =
+{
+    { "alu",    ROM_ALU,    sizeof(ROM_ALU) },
+    { "draw",   ROM_DRAW,   sizeof(ROM_DRAW) },
+    { "call",   ROM_CALL,   sizeof(ROM_CALL) },
+    { "memory", ROM_MEMORY, sizeof(ROM_MEMORY) },
+};
+
+static const struct { const char *name; Engine engine; } ENGINES[] =
+{
+    { "switch", ENGINE_SWITCH },
+    { "cached", ENGINE_CACHED },
+    { "jit",    ENGINE_JIT },
+};
+
+#define COUNT(array) (sizeof(array) / sizeof((array)[0]))
+
+// Fresh machine with a little of everything set so handlers take realistic paths
+static void ResetMachine(CHIP8 *cpu)
+{
+    memset(cpu, 0, sizeof(CHIP8));
+    InitializeCPU(cpu);
+    cpu->dataRegisters[1] = 0x05;
+    cpu->dataRegisters[2] = 0x07;
+    cpu->dataRegisters[3] = 0x03;
+    cpu->inputKeys[3] = 0xFF;
+    cpu->inputKeys[1] = 0xFF;
+}
+
+static double TimeOpcode(CHIP8 *cpu, const OpcodeBench *bench, unsigned long iterations, int withExecute)
+{
+    unsigned long i;
+    double start = Now();
+
+    for(i = 0; i < iterations; ++i)
+    {
+        bench->prepare(cpu);
+        if(withExecute)
+            bench->execute(cpu, bench->inst);
+    }
+
+    return Now() - start;
+}
+
+int main(int argc, char **argv)
+{
+    static CHIP8 cpu;
+    unsigned long opcodeIterations = 10000000;
+    unsigned long romCycles = 100000000;
+    size_t i, j;
+
+    if(argc > 1 && strcmp(argv[1], "--quick") == 0)
+    {
+        opcodeIterations /= 100;
+        romCycles /= 100;
+    }
+
+    printf("{\n  \"opcodes\": [\n");
+    for(i = 0; i < COUNT(OPCODES); ++i)
+    {
+        double total, overhead;
+
+        ResetMachine(&cpu);
+        total = TimeOpcode(&cpu, &OPCODES[i], opcodeIterations, 1);
+        ResetMachine(&cpu);
+        overhead = TimeOpcode(&cpu, &OPCODES[i], opcodeIterations, 0);
+
+        printf("    { \"opcode\": \"%s\", \"ns_per_instruction\": %.3f }%s\n", OPCODES[i].name,
+               (total - overhead) * 1e9 / opcodeIterations, i + 1 < COUNT(OPCODES) ? "," : "");
+    }
+
+    printf("  ],\n  \"roms\": [\n");
+    for(i = 0; i < COUNT(ROMS); ++i)
+    {
+        for(j = 0; j < COUNT(ENGINES); ++j)
+        {
+            double seconds;
+
+            ResetMachine(&cpu);
+            memcpy(&cpu.mainMemory[PROGRAM_START], ROMS[i].rom, ROMS[i].size);
+
+            // Measure raw interpretation, not how well idle loops are skipped
+            cpu.idleSkip = 0;
+            if(SetEngine(&cpu, ENGINES[j].engine) != 0)
+            {
+                printf("    { \"rom\": ");
+                WriteJSONString(ROMS[i].name, stdout);
+                printf(", \"engine\": \"%s\", \"supported\": false },\n", ENGINES[j].name);
+                continue;
+            }
+
+            seconds = Now();
+            RunCycles(&cpu, romCycles);
+            seconds = Now() - seconds;
+            ReleaseEngine(&cpu);
+
+            printf("    { \"rom\": ");
+            WriteJSONString(ROMS[i].name, stdout);
+            printf(", \"engine\": \"%s\", \"instructions\": %lu, "
+                   "\"seconds\": %.6f, \"instructions_per_second\": %.0f },\n",
+                   ENGINES[j].name, romCycles, seconds, romCycles / seconds);
+        }
+
+        // The same work spread over a full lockstep group, counting every lane
+        {
+            Lockstep *group;
+            unsigned long perLane = romCycles / LOCKSTEP_LANES;
+            double seconds;
+
+            ResetMachine(&cpu);
+            memcpy(&cpu.mainMemory[PROGRAM_START], ROMS[i].rom, ROMS[i].size);
+            if((group = CreateLockstep(&cpu, LOCKSTEP_LANES)) == NULL)
+                return -1;
+
+            seconds = Now();
+            RunLockstep(group, perLane);
+            seconds = Now() - seconds;
+            DestroyLockstep(group);
+
+            printf("    { \"rom\": ");
+            WriteJSONString(ROMS[i].name, stdout);
+            printf(", \"engine\": \"lockstep\", \"lanes\": %d, \"instructions\": %lu, "
+                   "\"seconds\": %.6f, \"instructions_per_second\": %.0f }%s\n",
+                   LOCKSTEP_LANES, perLane * LOCKSTEP_LANES, seconds,
+                   perLane * LOCKSTEP_LANES / seconds, i + 1 < COUNT(ROMS) ? "," : "");
+        }
+    }
+    printf("  ]\n}\n");
+
+    return 0;
+}
@@ -0,0 +1,249 @@
+#include <stdlib.h>
+#include "cache.h"
+#include "profile.h"
+#include "quirks.h"
+
+// Handler numbers stored in DecodedInst.op. OP_MISS must stay zero so a freshly
+// allocated cache is entirely undecoded
+enum
+{
+    OP_MISS, OP_NOP,
+    OP_00E0, OP_00EE, OP_1NNN, OP_2NNN, OP_3XNN, OP_4XNN, OP_5XY0, OP_6XNN, OP_7XNN,
+    OP_8XY0, OP_8XY1, OP_8XY2, OP_8XY3, OP_8XY4, OP_8XY5, OP_8XY6, OP_8XY7, OP_8XYE,
+    OP_9XY0, OP_ANNN, OP_BNNN, OP_CXNN, OP_DXYN, OP_EX9E, OP_EXA1,
+    OP_FX07, OP_FX0A, OP_FX15, OP_FX18, OP_FX1E, OP_FX29, OP_FX33, OP_FX55, OP_FX65,
+
+    // SUPER-CHIP extensions
+    OP_00CN, OP_00FB, OP_00FC, OP_00FD, OP_00FE, OP_00FF, OP_FX30, OP_FX75, OP_FX85,
+
+    // Superinstructions, named after the sequence they run
+    OP_ANNN_DXYN, OP_ANNN_FX33, OP_ANNN_FX55, OP_ANNN_FX65, OP_6XNN_6XNN, OP_FX07_3XNN_1NNN
+};
+
+// Sequences common enough in ROMs to be worth a handler of their own. Only the
+// last instruction of a sequence may store or jump, so the earlier ones can
+// never change what follows them. An earlier one may skip, as the 3XNN of the
+// timer poll does, if its handler then leaves out the rest of the sequence
+static const struct
+{
+    BYTE ops[MAX_FUSED];    // Handlers of the instructions, OP_MISS past the end
+    BYTE fused;             // Handler that runs them all
+} fusions[] =
+{
+    { { OP_ANNN, OP_DXYN }, OP_ANNN_DXYN },         // Point I at a sprite and draw it
+    { { OP_ANNN, OP_FX33 }, OP_ANNN_FX33 },         // Point I at a buffer and fill it
+    { { OP_ANNN, OP_FX55 }, OP_ANNN_FX55 },
+    { { OP_ANNN, OP_FX65 }, OP_ANNN_FX65 },         // Point I at a table and load from it
+    { { OP_6XNN, OP_6XNN }, OP_6XNN_6XNN },         // Register setup, often for a DXYN
+    { { OP_FX07, OP_3XNN, OP_1NNN }, OP_FX07_3XNN_1NNN }  // Poll the delay timer
+};
+
+// Pick the handler for an opcode. Mirrors the switch chain in DecodeExecute
+static BYTE SelectHandler(WORD inst)
+{
+    switch(inst & 0xF000)
+    {
+        case 0x0000:
+            if(inst == 0x00E0) return OP_00E0;
+            if(inst == 0x00EE) return OP_00EE;
+            if(inst == 0x00FB) return OP_00FB;
+            if(inst == 0x00FC) return OP_00FC;
+            if(inst == 0x00FD) return OP_00FD;
+            if(inst == 0x00FE) return OP_00FE;
+            if(inst == 0x00FF) return OP_00FF;
+            if((inst & 0xFFF0) == 0x00C0) return OP_00CN;
+            return OP_NOP;
+        case 0x1000: return OP_1NNN;
+        case 0x2000: return OP_2NNN;
+        case 0x3000: return OP_3XNN;
+        case 0x4000: return OP_4XNN;
+        case 0x5000: return OP_5XY0;
+        case 0x6000: return OP_6XNN;
+        case 0x7000: return OP_7XNN;
+        case 0x8000:
+            switch(inst & 0x000F)
+            {
+                case 0x0000: return OP_8XY0;
+                case 0x0001: return OP_8XY1;
+                case 0x0002: return OP_8XY2;
+                case 0x0003: return OP_8XY3;
+                case 0x0004: return OP_8XY4;
+                case 0x0005: return OP_8XY5;
+                case 0x0006: return OP_8XY6;
+                case 0x0007: return OP_8XY7;
+                case 0x000E: return OP_8XYE;
+                default: return OP_NOP;
+            }
+        case 0x9000: return OP_9XY0;
+        case 0xA000: return OP_ANNN;
+        case 0xB000: return OP_BNNN;
+        case 0xC000: return OP_CXNN;
+        case 0xD000: return OP_DXYN;
+        case 0xE000:
+            switch(inst & 0xF0FF)
+            {
+                case 0xE09E: return OP_EX9E;
+                case 0xE0A1: return OP_EXA1;
+                default: return OP_NOP;
+            }
+        default:
+            switch(inst & 0x00FF)
+            {
+                case 0x0007: return OP_FX07;
+                case 0x000A: return OP_FX0A;
+                case 0x0015: return OP_FX15;
+                case 0x0018: return OP_FX18;
+                case 0x001E: return OP_FX1E;
+                case 0x0029: return OP_FX29;
+                case 0x0030: return OP_FX30;
+                case 0x0033: return OP_FX33;
+                case 0x0055: return OP_FX55;
+                case 0x0065: return OP_FX65;
+                case 0x0075: return OP_FX75;
+                case 0x0085: return OP_FX85;
+                default: return OP_NOP;
+            }
+    }
+}
+
+// Fill in everything but the handler for the instruction at addr
+static void DecodeOperands(CHIP8 *cpu, DecodedInst *d, WORD addr)
+{
+    d->inst = cpu->mainMemory[addr] << 8 | cpu->mainMemory[(addr + 1) & ADDRESS_MASK];
+    d->nnn = d->inst & 0x0FFF;
+    d->x = (d->inst & 0x0F00) >> 8;
+    d->y = (d->inst & 0x00F0) >> 4;
+    d->nn = d->inst & 0x00FF;
+}
+
+// Fill in the record for the instruction at addr. If a fusable sequence starts
+// there the record runs all of it, reading the later instructions' operands
+// from their own records, which are filled in here. Their handlers are left
+// alone so jumping into the middle of a sequence still works
+static void DecodeInto(CHIP8 *cpu, DecodedInst *d, WORD addr)
+{
+    BYTE ops[MAX_FUSED];
+    unsigned int i, j;
+
+    DecodeOperands(cpu, d, addr);
+    d->op = SelectHandler(d->inst);
+
+    // Sequences never wrap round memory, so d[2] and d[4] are the records after d
+    ops[0] = d->op;
+    for(i = 1; i < MAX_FUSED; ++i)
+    {
+        WORD next = addr + 2 * i;
+        ops[i] = next < MEMORY_SIZE - 1 ?
+                 SelectHandler(cpu->mainMemory[next] << 8 | cpu->mainMemory[next + 1]) : OP_MISS;
+    }
+
+    for(i = 0; i < sizeof(fusions) / sizeof(fusions[0]); ++i)
+    {
+        for(j = 0; j < MAX_FUSED && fusions[i].ops[j] != OP_MISS; ++j)
+        {
+            if(fusions[i].ops[j] != ops[j])
+                break;
+        }
+        if(j == MAX_FUSED || fusions[i].ops[j] == OP_MISS)
+        {
+            for(j = 1; j < MAX_FUSED && fusions[i].ops[j] != OP_MISS; ++j)
+                DecodeOperands(cpu, &d[2 * j], addr + 2 * j);
+            d->op = fusions[i].fused;
+            return;
+        }
+    }
+}
+
+DecodeCache *CreateDecodeCache(void)
+{
+    return calloc(1, sizeof(DecodeCache));
+}
+
+void DestroyDecodeCache(DecodeCache *cache)
+{
+    free(cache);
+}
+
+void InvalidateDecoded(DecodeCache *cache, WORD addr)
+{
+    int i;
+
+    // A record covers up to MAX_FUSED instructions, so any of the records
+    // starting in the 2 * MAX_FUSED bytes up to addr may read the byte
+    for(i = 0; i < 2 * MAX_FUSED; ++i)
+        cache->entries[(addr - i) & ADDRESS_MASK].op = OP_MISS;
+}
+
+// With GCC every handler ends in its own indirect jump (threaded code), which
+// predicts far better than one shared dispatch point. Other compilers get a
+// plain switch over the same handler bodies
+#ifdef __GNUC__
+#define CASE(op)    op_##op:
+#define DISPATCH()  goto *labels[d->op]
+#else
+#define CASE(op)    case OP_##op: op_##op:
+#define DISPATCH()  goto dispatch
+#endif
+
+// Superinstructions that would run past the end of count execute just their
+// first instruction through its usual handler
+#define UNFUSED(op) goto op_##op
+
+// PC lives in a local while handlers run and is only synced around calls into
+// the core executors, which read and write cpu->PC themselves. Like cpu->PC it
+// always stays inside memory
+#define CALL(call)      \
+    cpu->PC = pc;       \
+    call;               \
+    pc = cpu->PC
+
+#define NEXT()                                  \
+    do                                          \
+    {                                           \
+        if(count-- == 0)                        \
+        {                                       \
+            cpu->PC = pc;                       \
+            return;                             \
+        }                                       \
+        PROFILE_INSTRUCTION(cpu, pc);           \
+        d = &entries[pc];                       \
+        pc = (pc + 2) & ADDRESS_MASK;           \
+        DISPATCH();                             \
+    } while(0)
+
+// One specialized copy of the loop per profile. Label addresses are a GNU
+// extension, which -Wpedantic would flag in every handler
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+#define QUIRK_PROFILE MODERN
+#include "cacheloop.h"
+#undef QUIRK_PROFILE
+
+#define QUIRK_PROFILE VIP
+#include "cacheloop.h"
+#undef QUIRK_PROFILE
+
+#define QUIRK_PROFILE CHIP48
+#include "cacheloop.h"
+#undef QUIRK_PROFILE
+
+#define QUIRK_PROFILE SCHIP
+#include "cacheloop.h"
+#undef QUIRK_PROFILE
+
+#define QUIRK_PROFILE XOCHIP
+#include "cacheloop.h"
+#undef QUIRK_PROFILE
+
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+// The profile is fixed for the whole call, so the loop never tests a quirk
+void RunCyclesCached(CHIP8 *cpu, unsigned long count)
+{
+    QUIRK_SELECT(cpu, RunCyclesCached, (cpu, count));
+}
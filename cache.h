@@ -0,0 +1,37 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "chip8core.h"
+
+// An instruction decoded once, with its operands already pulled out of the opcode
+typedef struct DecodedInst
+{
+    WORD inst;  // Raw opcode, for handlers that defer to the core executors
+    WORD nnn;   // Address operand
+    BYTE op;    // Handler to run, zero until the address is decoded
+    BYTE x;     // First register operand
+    BYTE y;     // Second register operand
+    BYTE nn;    // BYTE operand
+} DecodedInst;
+
+// Longest run of instructions one record can execute with a single dispatch. A
+// fused record also relies on the operands of the records after it, see cache.c
+#define MAX_FUSED 3
+
+// One record per memory address. Records are decoded on first execution and
+// reused until a store lands on any byte of the instructions they cover
+typedef struct DecodeCache
+{
+    DecodedInst entries[MEMORY_SIZE];
+} DecodeCache;
+
+DecodeCache *CreateDecodeCache(void);
+void DestroyDecodeCache(DecodeCache *cache);
+
+// Forget every record that covers the byte at addr, fused or not
+void InvalidateDecoded(DecodeCache *cache, WORD addr);
+
+// Execute count instructions through the cache
+void RunCyclesCached(CHIP8 *cpu, unsigned long count);
+
+#endif
@@ -0,0 +1,317 @@
+// The ENGINE_CACHED loop for one quirk profile. Included by cache.c once per
+// profile with QUIRK_PROFILE defined, see quirks.h, so this header deliberately
+// has no include guard. Handlers for quirk-dependent opcodes call that
+// profile's executors directly
+
+static void QUIRKED(RunCyclesCached)(CHIP8 *cpu, unsigned long count)
+{
+    DecodedInst *entries = cpu->decodeCache->entries;
+    BYTE *v = cpu->dataRegisters;
+    WORD pc = cpu->PC & ADDRESS_MASK;
+    DecodedInst *d;
+
+#ifdef __GNUC__
+    // Same order as the OP_ enum
+    static const void *labels[] =
+    {
+        &&op_MISS, &&op_NOP,
+        &&op_00E0, &&op_00EE, &&op_1NNN, &&op_2NNN, &&op_3XNN, &&op_4XNN, &&op_5XY0, &&op_6XNN, &&op_7XNN,
+        &&op_8XY0, &&op_8XY1, &&op_8XY2, &&op_8XY3, &&op_8XY4, &&op_8XY5, &&op_8XY6, &&op_8XY7, &&op_8XYE,
+        &&op_9XY0, &&op_ANNN, &&op_BNNN, &&op_CXNN, &&op_DXYN, &&op_EX9E, &&op_EXA1,
+        &&op_FX07, &&op_FX0A, &&op_FX15, &&op_FX18, &&op_FX1E, &&op_FX29, &&op_FX33, &&op_FX55, &&op_FX65,
+        &&op_00CN, &&op_00FB, &&op_00FC, &&op_00FD, &&op_00FE, &&op_00FF, &&op_FX30, &&op_FX75, &&op_FX85,
+        &&op_ANNN_DXYN, &&op_ANNN_FX33, &&op_ANNN_FX55, &&op_ANNN_FX65, &&op_6XNN_6XNN, &&op_FX07_3XNN_1NNN
+    };
+#endif
+
+    NEXT();
+
+#ifndef __GNUC__
+dispatch:
+    switch(d->op)
+    {
+#endif
+    // First execution at this address. Decode, then run the real handler
+    CASE(MISS)
+        DecodeInto(cpu, d, (pc - 2) & ADDRESS_MASK);
+        DISPATCH();
+
+    // 0NNN and unknown opcodes do nothing
+    CASE(NOP)
+        NEXT();
+
+    CASE(00E0)
+        CALL(Execute00E0(cpu));
+        NEXT();
+
+    CASE(00EE)
+        CALL(Execute00EE(cpu));
+        NEXT();
+
+    // Jumping backwards may close a busy-wait loop
+    CASE(1NNN)
+        if(d->nnn < pc)
+        {
+            cpu->PC = pc = d->nnn;
+            count -= IdleSkip(cpu, count);
+        }
+        else
+            pc = d->nnn;
+        NEXT();
+
+    // Stores go through the core so they invalidate this cache
+    CASE(2NNN)
+        CALL(Execute2NNN(cpu, d->inst));
+        NEXT();
+
+    CASE(3XNN)
+        if(v[d->x] == d->nn)
+            pc = (pc + 2) & ADDRESS_MASK;
+        NEXT();
+
+    CASE(4XNN)
+        if(v[d->x] != d->nn)
+            pc = (pc + 2) & ADDRESS_MASK;
+        NEXT();
+
+    CASE(5XY0)
+        if(v[d->x] == v[d->y])
+            pc = (pc + 2) & ADDRESS_MASK;
+        NEXT();
+
+    CASE(6XNN)
+        v[d->x] = d->nn;
+        NEXT();
+
+    CASE(7XNN)
+        v[d->x] += d->nn;
+        NEXT();
+
+    CASE(8XY0)
+        v[d->x] = v[d->y];
+        NEXT();
+
+    CASE(8XY1)
+        v[d->x] |= v[d->y];
+        NEXT();
+
+    CASE(8XY2)
+        v[d->x] &= v[d->y];
+        NEXT();
+
+    CASE(8XY3)
+        v[d->x] ^= v[d->y];
+        NEXT();
+
+    // VF is written before Vx, exactly as in Execute8XY4
+    CASE(8XY4)
+        v[0xF] = v[d->x] + v[d->y] > 0xFF;
+        v[d->x] += v[d->y];
+        NEXT();
+
+    CASE(8XY5)
+        v[0xF] = v[d->x] > v[d->y];
+        v[d->x] = v[d->x] - v[d->y];
+        NEXT();
+
+    CASE(8XY6)
+        CALL(QUIRKED(Execute8XY6)(cpu, d->inst));
+        NEXT();
+
+    CASE(8XY7)
+        v[0xF] = v[d->y] > v[d->x];
+        v[d->x] = v[d->y] - v[d->x];
+        NEXT();
+
+    CASE(8XYE)
+        CALL(QUIRKED(Execute8XYE)(cpu, d->inst));
+        NEXT();
+
+    CASE(9XY0)
+        if(v[d->x] != v[d->y])
+            pc = (pc + 2) & ADDRESS_MASK;
+        NEXT();
+
+    CASE(ANNN)
+        cpu->regI = d->nnn;
+        NEXT();
+
+    CASE(BNNN)
+        CALL(QUIRKED(ExecuteBNNN)(cpu, d->inst));
+        NEXT();
+
+    CASE(CXNN)
+        CALL(ExecuteCXNN(cpu, d->inst));
+        NEXT();
+
+    CASE(DXYN)
+        CALL(QUIRKED(ExecuteDXYN)(cpu, d->inst));
+        NEXT();
+
+    CASE(EX9E)
+        if(cpu->inputKeys[v[d->x] & (NUM_KEYS - 1)] == 0xFF)
+            pc = (pc + 2) & ADDRESS_MASK;
+        NEXT();
+
+    CASE(EXA1)
+        if(cpu->inputKeys[v[d->x] & (NUM_KEYS - 1)] == 0x00)
+            pc = (pc + 2) & ADDRESS_MASK;
+        NEXT();
+
+    CASE(FX07)
+        v[d->x] = cpu->regDT;
+        NEXT();
+
+    // A blocked key wait re-executes itself, which IdleSkip treats as a loop
+    CASE(FX0A)
+        CALL(ExecuteFX0A(cpu, d->inst));
+        if(pc == d - entries)
+            count -= IdleSkip(cpu, count);
+        NEXT();
+
+    CASE(FX15)
+        cpu->regDT = v[d->x];
+        NEXT();
+
+    CASE(FX18)
+        cpu->regST = v[d->x];
+        NEXT();
+
+    CASE(FX1E)
+        cpu->regI += v[d->x];
+        NEXT();
+
+    CASE(FX29)
+        CALL(ExecuteFX29(cpu, d->inst));
+        NEXT();
+
+    CASE(FX33)
+        CALL(ExecuteFX33(cpu, d->inst));
+        NEXT();
+
+    CASE(FX55)
+        CALL(QUIRKED(ExecuteFX55)(cpu, d->inst));
+        NEXT();
+
+    CASE(FX65)
+        CALL(QUIRKED(ExecuteFX65)(cpu, d->inst));
+        NEXT();
+
+    CASE(00CN)
+        CALL(Execute00CN(cpu, d->inst));
+        NEXT();
+
+    CASE(00FB)
+        CALL(Execute00FB(cpu));
+        NEXT();
+
+    CASE(00FC)
+        CALL(Execute00FC(cpu));
+        NEXT();
+
+    // Exiting spins on the spot, just like a blocked key wait
+    CASE(00FD)
+        CALL(Execute00FD(cpu));
+        if(pc == d - entries)
+            count -= IdleSkip(cpu, count);
+        NEXT();
+
+    CASE(00FE)
+        CALL(Execute00FE(cpu));
+        NEXT();
+
+    CASE(00FF)
+        CALL(Execute00FF(cpu));
+        NEXT();
+
+    CASE(FX30)
+        CALL(ExecuteFX30(cpu, d->inst));
+        NEXT();
+
+    CASE(FX75)
+        CALL(ExecuteFX75(cpu, d->inst));
+        NEXT();
+
+    CASE(FX85)
+        CALL(ExecuteFX85(cpu, d->inst));
+        NEXT();
+
+    // Each superinstruction charges count and the profiler for every
+    // instruction it runs, and leaves pc where the last one would
+    CASE(ANNN_DXYN)
+        if(count == 0)
+            UNFUSED(ANNN);
+        --count;
+        PROFILE_INSTRUCTION(cpu, pc);
+        cpu->regI = d->nnn;
+        pc = (pc + 2) & ADDRESS_MASK;
+        CALL(QUIRKED(ExecuteDXYN)(cpu, d[2].inst));
+        NEXT();
+
+    CASE(ANNN_FX33)
+        if(count == 0)
+            UNFUSED(ANNN);
+        --count;
+        PROFILE_INSTRUCTION(cpu, pc);
+        cpu->regI = d->nnn;
+        pc = (pc + 2) & ADDRESS_MASK;
+        CALL(ExecuteFX33(cpu, d[2].inst));
+        NEXT();
+
+    CASE(ANNN_FX55)
+        if(count == 0)
+            UNFUSED(ANNN);
+        --count;
+        PROFILE_INSTRUCTION(cpu, pc);
+        cpu->regI = d->nnn;
+        pc = (pc + 2) & ADDRESS_MASK;
+        CALL(QUIRKED(ExecuteFX55)(cpu, d[2].inst));
+        NEXT();
+
+    CASE(ANNN_FX65)
+        if(count == 0)
+            UNFUSED(ANNN);
+        --count;
+        PROFILE_INSTRUCTION(cpu, pc);
+        cpu->regI = d->nnn;
+        pc = (pc + 2) & ADDRESS_MASK;
+        CALL(QUIRKED(ExecuteFX65)(cpu, d[2].inst));
+        NEXT();
+
+    CASE(6XNN_6XNN)
+        if(count == 0)
+            UNFUSED(6XNN);
+        --count;
+        PROFILE_INSTRUCTION(cpu, pc);
+        v[d->x] = d->nn;
+        v[d[2].x] = d[2].nn;
+        pc = (pc + 2) & ADDRESS_MASK;
+        NEXT();
+
+    // Either skips over the jump after two instructions or takes it after three.
+    // Needs room for three either way
+    CASE(FX07_3XNN_1NNN)
+        if(count < 2)
+            UNFUSED(FX07);
+        --count;
+        PROFILE_INSTRUCTION(cpu, pc);
+        v[d->x] = cpu->regDT;
+        if(v[d[2].x] == d[2].nn)
+            pc = (pc + 4) & ADDRESS_MASK;
+        else
+        {
+            --count;
+            PROFILE_INSTRUCTION(cpu, pc + 2);
+            if(d[4].nnn < ((pc + 4) & ADDRESS_MASK))
+            {
+                cpu->PC = pc = d[4].nnn;
+                count -= IdleSkip(cpu, count);
+            }
+            else
+                pc = d[4].nnn;
+        }
+        NEXT();
+#ifndef __GNUC__
+    }
+#endif
+}
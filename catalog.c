@@ -0,0 +1,562 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "catalog.h"
+
+// 64-bit FNV-1a
+#define HASH_BASIS 0xCBF29CE484222325ULL
+#define HASH_PRIME 0x100000001B3ULL
+
+// Slots a catalogue starts with once it holds anything
+#define MIN_CAPACITY 16
+
+// Version 1 headers ended before the path counts
+#define HEADER_SIZE_V1 16
+
+// Buffer for any one header or slot
+#define BUFFER_SIZE CATALOG_SLOT_SIZE
+
+static uint64_t FinishHash(uint64_t hash)
+{
+    // Zero marks an empty slot
+    return hash != 0 ? hash : 1;
+}
+
+uint64_t HashROM(const BYTE *rom, size_t size)
+{
+    uint64_t hash = HASH_BASIS;
+    size_t i;
+
+    for(i = 0; i < size; ++i)
+        hash = (hash ^ rom[i]) * HASH_PRIME;
+    return FinishHash(hash);
+}
+
+uint64_t HashPath(const char *path)
+{
+    return HashROM((const BYTE *)path, strlen(path));
+}
+
+int ReadROMFile(const char *path, BYTE *rom, size_t capacity, size_t *size)
+{
+    FILE *input;
+    int result = 0;
+
+    if((input = fopen(path, "rb")) == NULL)
+        return -1;
+
+    // Anything left over after capacity bytes means the file is too large
+    *size = fread(rom, 1, capacity, input);
+    if(ferror(input) || fgetc(input) != EOF)
+        result = -1;
+    fclose(input);
+
+    return result;
+}
+
+// Opcodes only XO-CHIP has: 00DN, 5XY2, 5XY3, F000 NNNN, FN01, F002 and FX3A
+static int IsXOCHIPOpcode(WORD inst)
+{
+    return (inst & 0xFFF0) == 0x00D0 || (inst & 0xF00F) == 0x5002 || (inst & 0xF00F) == 0x5003 ||
+           inst == 0xF000 || (inst & 0xF0FF) == 0xF001 || inst == 0xF002 || (inst & 0xF0FF) == 0xF03A;
+}
+
+// Opcodes SUPER-CHIP added: 00CN, 00FB - 00FF, FX30, FX75 and FX85
+static int IsSCHIPOpcode(WORD inst)
+{
+    return (inst & 0xFFF0) == 0x00C0 || (inst >= 0x00FB && inst <= 0x00FF) ||
+           (inst & 0xF0FF) == 0xF030 || (inst & 0xF0FF) == 0xF075 || (inst & 0xF0FF) == 0xF085;
+}
+
+// Addresses reached but not yet looked at, and every address ever reached
+typedef struct Walk
+{
+    WORD pending[MEMORY_SIZE];
+    int count;
+    BYTE reached[MEMORY_SIZE];
+} Walk;
+
+static void Reach(Walk *walk, WORD addr)
+{
+    addr &= ADDRESS_MASK;
+    if(!walk->reached[addr])
+    {
+        walk->reached[addr] = 1;
+        walk->pending[walk->count++] = addr;
+    }
+}
+
+// Only instructions control can reach are looked at, so sprites and other data
+// that happen to look like extension opcodes don't count. Control is followed
+// through jumps, calls and both sides of skips. Computed jumps and returns end a path
+Platform DetectPlatform(const BYTE *rom, size_t size)
+{
+    Walk walk;
+    Platform platform = PLATFORM_CHIP8;
+
+    // Only XO-CHIP has the memory for it
+    if(size > MAX_ROM_SIZE)
+        return PLATFORM_XOCHIP;
+
+    memset(walk.reached, 0, sizeof(walk.reached));
+    walk.count = 0;
+    Reach(&walk, PROGRAM_START);
+
+    while(walk.count > 0)
+    {
+        WORD addr = walk.pending[--walk.count];
+        WORD inst;
+
+        // Running off the end of the ROM leads nowhere worth following
+        if(addr < PROGRAM_START || addr + 2 > PROGRAM_START + size)
+            continue;
+        inst = rom[addr - PROGRAM_START] << 8 | rom[addr - PROGRAM_START + 1];
+
+        if(IsXOCHIPOpcode(inst))
+            return PLATFORM_XOCHIP;
+        if(IsSCHIPOpcode(inst))
+            platform = PLATFORM_SCHIP;
+
+        switch(inst & 0xF000)
+        {
+            case 0x0000:
+                if(inst != 0x00EE && inst != 0x00FD)
+                    Reach(&walk, addr + 2);
+                break;
+            case 0x1000:
+                Reach(&walk, inst);
+                break;
+            case 0x2000:
+                Reach(&walk, inst);
+                Reach(&walk, addr + 2);
+                break;
+            case 0x3000:
+            case 0x4000:
+            case 0x5000:
+            case 0x9000:
+            case 0xE000:
+                Reach(&walk, addr + 2);
+                Reach(&walk, addr + 4);
+                break;
+            case 0xB000:
+                break;
+            default:
+                Reach(&walk, addr + 2);
+                break;
+        }
+    }
+
+    return platform;
+}
+
+const char *PlatformName(Platform platform)
+{
+    switch(platform)
+    {
+        case PLATFORM_SCHIP:  return "schip";
+        case PLATFORM_XOCHIP: return "xochip";
+        default:              return "chip8";
+    }
+}
+
+int IsKeymap(const char *layout)
+{
+    int i;
+
+    for(i = 0; i < NUM_KEYS; ++i)
+    {
+        if(!isalnum((unsigned char)layout[i]) && (layout[i] == '\0' || strchr(" `-=[]\\;',./", layout[i]) == NULL))
+            return 0;
+    }
+    return 1;
+}
+
+void DefaultSettings(CatalogEntry *entry)
+{
+    switch(entry->platform)
+    {
+        case PLATFORM_SCHIP:
+            entry->quirks = QUIRKS_SCHIP;
+            entry->cyclesPerFrame = SCHIP_CYCLES_PER_FRAME;
+            break;
+        case PLATFORM_XOCHIP:
+            entry->quirks = QUIRKS_XOCHIP;
+            entry->cyclesPerFrame = XOCHIP_CYCLES_PER_FRAME;
+            break;
+        default:
+            entry->quirks = QUIRKS_MODERN;
+            entry->cyclesPerFrame = CYCLES_PER_FRAME;
+            break;
+    }
+    memset(entry->keymap, 0, NUM_KEYS);
+}
+
+void InitCatalog(Catalog *catalog)
+{
+    catalog->slots = NULL;
+    catalog->capacity = 0;
+    catalog->count = 0;
+    catalog->paths = NULL;
+    catalog->pathCapacity = 0;
+    catalog->pathCount = 0;
+}
+
+void FreeCatalog(Catalog *catalog)
+{
+    free(catalog->slots);
+    free(catalog->paths);
+    InitCatalog(catalog);
+}
+
+// The slot holding hash, or the empty slot it would go in
+static CatalogEntry *Probe(const Catalog *catalog, uint64_t hash)
+{
+    uint32_t slot = hash & (catalog->capacity - 1);
+
+    while(catalog->slots[slot].hash != 0 && catalog->slots[slot].hash != hash)
+        slot = (slot + 1) & (catalog->capacity - 1);
+    return &catalog->slots[slot];
+}
+
+CatalogEntry *FindEntry(const Catalog *catalog, uint64_t hash)
+{
+    CatalogEntry *entry;
+
+    if(catalog->capacity == 0)
+        return NULL;
+    entry = Probe(catalog, hash);
+    return entry->hash != 0 ? entry : NULL;
+}
+
+int AddEntry(Catalog *catalog, const CatalogEntry *entry)
+{
+    CatalogEntry *slot;
+
+    // Keep at most half the slots in use so probes stay short
+    if((catalog->count + 1) * 2 > catalog->capacity)
+    {
+        Catalog grown;
+        uint32_t i;
+
+        grown.capacity = catalog->capacity != 0 ? catalog->capacity * 2 : MIN_CAPACITY;
+        grown.count = catalog->count;
+        if((grown.slots = calloc(grown.capacity, sizeof(CatalogEntry))) == NULL)
+            return -1;
+        for(i = 0; i < catalog->capacity; ++i)
+        {
+            if(catalog->slots[i].hash != 0)
+                *Probe(&grown, catalog->slots[i].hash) = catalog->slots[i];
+        }
+        free(catalog->slots);
+        *catalog = grown;
+    }
+
+    slot = Probe(catalog, entry->hash);
+    if(slot->hash == 0)
+        ++catalog->count;
+    *slot = *entry;
+    return 0;
+}
+
+// The path slot holding pathHash, or the empty slot it would go in
+static CatalogPath *ProbePath(CatalogPath *paths, uint32_t capacity, uint64_t pathHash)
+{
+    uint32_t slot = pathHash & (capacity - 1);
+
+    while(paths[slot].pathHash != 0 && paths[slot].pathHash != pathHash)
+        slot = (slot + 1) & (capacity - 1);
+    return &paths[slot];
+}
+
+CatalogPath *FindPath(const Catalog *catalog, uint64_t pathHash)
+{
+    CatalogPath *path;
+
+    if(catalog->pathCapacity == 0)
+        return NULL;
+    path = ProbePath(catalog->paths, catalog->pathCapacity, pathHash);
+    return path->pathHash != 0 ? path : NULL;
+}
+
+int AddPath(Catalog *catalog, const CatalogPath *path)
+{
+    CatalogPath *slot;
+
+    // Grown the same way as the ROM slots
+    if((catalog->pathCount + 1) * 2 > catalog->pathCapacity)
+    {
+        uint32_t capacity = catalog->pathCapacity != 0 ? catalog->pathCapacity * 2 : MIN_CAPACITY;
+        CatalogPath *paths = calloc(capacity, sizeof(CatalogPath));
+        uint32_t i;
+
+        if(paths == NULL)
+            return -1;
+        for(i = 0; i < catalog->pathCapacity; ++i)
+        {
+            if(catalog->paths[i].pathHash != 0)
+                *ProbePath(paths, capacity, catalog->paths[i].pathHash) = catalog->paths[i];
+        }
+        free(catalog->paths);
+        catalog->paths = paths;
+        catalog->pathCapacity = capacity;
+    }
+
+    slot = ProbePath(catalog->paths, catalog->pathCapacity, path->pathHash);
+    if(slot->pathHash == 0)
+        ++catalog->pathCount;
+    *slot = *path;
+    return 0;
+}
+
+static void PutLong(BYTE *buffer, uint64_t value, int size)
+{
+    int i;
+
+    for(i = 0; i < size; ++i)
+        buffer[i] = value >> (i * 8);
+}
+
+static uint64_t GetLong(const BYTE *buffer, int size)
+{
+    uint64_t value = 0;
+    int i;
+
+    for(i = 0; i < size; ++i)
+        value |= (uint64_t)buffer[i] << (i * 8);
+    return value;
+}
+
+static void PutSlot(BYTE *buffer, const CatalogEntry *entry)
+{
+    PutLong(&buffer[0], entry->hash, 8);
+    PutLong(&buffer[8], entry->pathHash, 8);
+    PutLong(&buffer[16], (uint64_t)entry->modified, 8);
+    PutLong(&buffer[24], entry->size, 4);
+    buffer[28] = entry->platform;
+    buffer[29] = entry->quirks;
+    PutLong(&buffer[30], entry->cyclesPerFrame, 2);
+    memcpy(&buffer[32], entry->keymap, NUM_KEYS);
+}
+
+// Returns non-zero if the slot holds something no catalogue writes
+static int GetSlot(const BYTE *buffer, CatalogEntry *entry)
+{
+    entry->hash = GetLong(&buffer[0], 8);
+    entry->pathHash = GetLong(&buffer[8], 8);
+    entry->modified = (int64_t)GetLong(&buffer[16], 8);
+    entry->size = GetLong(&buffer[24], 4);
+    entry->platform = buffer[28];
+    entry->quirks = buffer[29];
+    entry->cyclesPerFrame = GetLong(&buffer[30], 2);
+    memcpy(entry->keymap, &buffer[32], NUM_KEYS);
+
+    return entry->hash != 0 &&
+           (buffer[28] > PLATFORM_XOCHIP || buffer[29] > QUIRKS_XOCHIP || entry->cyclesPerFrame == 0 ||
+            (entry->keymap[0] != '\0' && !IsKeymap(entry->keymap)));
+}
+
+static void PutPath(BYTE *buffer, const CatalogPath *path)
+{
+    PutLong(&buffer[0], path->pathHash, 8);
+    PutLong(&buffer[8], path->hash, 8);
+    PutLong(&buffer[16], (uint64_t)path->modified, 8);
+    PutLong(&buffer[24], path->size, 4);
+    PutLong(&buffer[28], 0, 4);
+}
+
+// Returns non-zero if the slot holds something no catalogue writes
+static int GetPath(const BYTE *buffer, CatalogPath *path)
+{
+    path->pathHash = GetLong(&buffer[0], 8);
+    path->hash = GetLong(&buffer[8], 8);
+    path->modified = (int64_t)GetLong(&buffer[16], 8);
+    path->size = GetLong(&buffer[24], 4);
+
+    return path->pathHash != 0 && path->hash == 0;
+}
+
+// Whether count of capacity slots in use is a table some catalogue could write
+static int GoodTable(uint32_t capacity, uint32_t count)
+{
+    return capacity != 0 && (capacity & (capacity - 1)) == 0 && (uint64_t)count * 2 <= capacity;
+}
+
+// Read and check the header of either version into header, returning its size,
+// or zero if it is malformed. A version 1 header has no path table
+static size_t ReadHeader(FILE *input, BYTE *header)
+{
+    if(fread(header, HEADER_SIZE_V1, 1, input) != 1 || memcmp(header, CATALOG_MAGIC, 4) != 0 ||
+       !GoodTable(GetLong(&header[8], 4), GetLong(&header[12], 4)))
+        return 0;
+
+    if(GetLong(&header[4], 2) == 1)
+    {
+        memset(&header[HEADER_SIZE_V1], 0, CATALOG_HEADER_SIZE - HEADER_SIZE_V1);
+        return HEADER_SIZE_V1;
+    }
+    if(GetLong(&header[4], 2) != CATALOG_VERSION ||
+       fread(&header[HEADER_SIZE_V1], CATALOG_HEADER_SIZE - HEADER_SIZE_V1, 1, input) != 1 ||
+       !GoodTable(GetLong(&header[16], 4), GetLong(&header[20], 4)))
+        return 0;
+    return CATALOG_HEADER_SIZE;
+}
+
+int SaveCatalog(const Catalog *catalog, const char *path)
+{
+    static const CatalogEntry empty;
+    static const CatalogPath emptyPath;
+    BYTE buffer[BUFFER_SIZE];
+    uint32_t capacity = catalog->capacity != 0 ? catalog->capacity : MIN_CAPACITY;
+    uint32_t pathCapacity = catalog->pathCapacity != 0 ? catalog->pathCapacity : MIN_CAPACITY;
+    FILE *output;
+    uint32_t i;
+    int result = 0;
+
+    if((output = fopen(path, "wb")) == NULL)
+        return -1;
+
+    memcpy(buffer, CATALOG_MAGIC, 4);
+    PutLong(&buffer[4], CATALOG_VERSION, 2);
+    PutLong(&buffer[6], 0, 2);
+    PutLong(&buffer[8], capacity, 4);
+    PutLong(&buffer[12], catalog->count, 4);
+    PutLong(&buffer[16], pathCapacity, 4);
+    PutLong(&buffer[20], catalog->pathCount, 4);
+    if(fwrite(buffer, CATALOG_HEADER_SIZE, 1, output) != 1)
+        result = -1;
+
+    for(i = 0; i < capacity && result == 0; ++i)
+    {
+        PutSlot(buffer, catalog->capacity != 0 ? &catalog->slots[i] : &empty);
+        if(fwrite(buffer, CATALOG_SLOT_SIZE, 1, output) != 1)
+            result = -1;
+    }
+
+    for(i = 0; i < pathCapacity && result == 0; ++i)
+    {
+        PutPath(buffer, catalog->pathCapacity != 0 ? &catalog->paths[i] : &emptyPath);
+        if(fwrite(buffer, CATALOG_PATH_SIZE, 1, output) != 1)
+            result = -1;
+    }
+
+    if(fclose(output) != 0)
+        result = -1;
+    return result;
+}
+
+int LoadCatalog(Catalog *catalog, const char *path)
+{
+    BYTE buffer[BUFFER_SIZE];
+    Catalog loaded;
+    uint32_t count, pathCount, i;
+    size_t headerSize;
+    FILE *input;
+    int damaged = 0;
+
+    if((input = fopen(path, "rb")) == NULL)
+        return -1;
+
+    InitCatalog(&loaded);
+    if((headerSize = ReadHeader(input, buffer)) == 0)
+    {
+        fclose(input);
+        return -1;
+    }
+    loaded.capacity = GetLong(&buffer[8], 4);
+    count = GetLong(&buffer[12], 4);
+    loaded.pathCapacity = GetLong(&buffer[16], 4);
+    pathCount = GetLong(&buffer[20], 4);
+
+    loaded.slots = calloc(loaded.capacity, sizeof(CatalogEntry));
+    if(loaded.pathCapacity != 0)
+        loaded.paths = calloc(loaded.pathCapacity, sizeof(CatalogPath));
+    if(loaded.slots == NULL || (loaded.pathCapacity != 0 && loaded.paths == NULL))
+    {
+        FreeCatalog(&loaded);
+        fclose(input);
+        return -1;
+    }
+
+    // Slots are read into place, so the tables need no rebuilding
+    for(i = 0; i < loaded.capacity && !damaged; ++i)
+    {
+        damaged = fread(buffer, CATALOG_SLOT_SIZE, 1, input) != 1 || GetSlot(buffer, &loaded.slots[i]) != 0;
+        loaded.count += loaded.slots[i].hash != 0;
+    }
+    for(i = 0; i < loaded.pathCapacity && !damaged; ++i)
+    {
+        damaged = fread(buffer, CATALOG_PATH_SIZE, 1, input) != 1 || GetPath(buffer, &loaded.paths[i]) != 0;
+        loaded.pathCount += loaded.paths[i].pathHash != 0;
+    }
+
+    // Short files, trailing bytes or counts that disagree with the slots mean a damaged file
+    if(damaged || fgetc(input) != EOF || loaded.count != count || loaded.pathCount != pathCount)
+    {
+        fclose(input);
+        FreeCatalog(&loaded);
+        return -1;
+    }
+    fclose(input);
+
+    // A version 1 file only knows each ROM's last file
+    for(i = 0; headerSize == HEADER_SIZE_V1 && i < loaded.capacity; ++i)
+    {
+        CatalogPath last;
+
+        if(loaded.slots[i].hash == 0)
+            continue;
+        last.pathHash = loaded.slots[i].pathHash;
+        last.hash = loaded.slots[i].hash;
+        last.modified = loaded.slots[i].modified;
+        last.size = loaded.slots[i].size;
+        if(AddPath(&loaded, &last) != 0)
+        {
+            FreeCatalog(&loaded);
+            return -1;
+        }
+    }
+
+    FreeCatalog(catalog);
+    *catalog = loaded;
+    return 0;
+}
+
+int LookupCatalog(const char *path, uint64_t hash, CatalogEntry *entry)
+{
+    BYTE buffer[BUFFER_SIZE];
+    uint32_t capacity, slot, probes;
+    size_t headerSize;
+    FILE *input;
+    int result = -1;
+
+    if((input = fopen(path, "rb")) == NULL)
+        return -1;
+
+    if((headerSize = ReadHeader(input, buffer)) == 0)
+    {
+        fclose(input);
+        return -1;
+    }
+    capacity = GetLong(&buffer[8], 4);
+
+    // Read slots from the hash's home until it turns up or an empty slot shows
+    // it was never added. With the table at most half full that is a read or two
+    slot = hash & (capacity - 1);
+    for(probes = 0; probes < capacity; ++probes)
+    {
+        if(fseek(input, headerSize + (long)slot * CATALOG_SLOT_SIZE, SEEK_SET) != 0 ||
+           fread(buffer, CATALOG_SLOT_SIZE, 1, input) != 1 || GetSlot(buffer, entry) != 0 ||
+           entry->hash == 0)
+            break;
+        if(entry->hash == hash)
+        {
+            result = 0;
+            break;
+        }
+        slot = (slot + 1) & (capacity - 1);
+    }
+
+    fclose(input);
+    return result;
+}
@@ -0,0 +1,139 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <stddef.h>
+#include "chip8core.h"
+
+// Machines a ROM can be written for, told apart by the opcodes it uses
+typedef enum Platform
+{
+    PLATFORM_CHIP8,
+    PLATFORM_SCHIP,     // Uses the SUPER-CHIP scrolling, resolution, font or flag opcodes
+    PLATFORM_XOCHIP     // Uses XO-CHIP opcodes, or is too large for anything else
+} Platform;
+
+// Instructions per frame a newly catalogued ROM starts with, by platform
+#define SCHIP_CYCLES_PER_FRAME 30
+#define XOCHIP_CYCLES_PER_FRAME 1000
+
+// Largest ROM the indexer reads. XO-CHIP programs may fill 64K of memory
+#define MAX_CATALOG_ROM_SIZE 0x10000
+
+// Everything the catalogue knows about one ROM. Entries are keyed by content,
+// and remember the file they were last indexed from
+typedef struct CatalogEntry
+{
+    uint64_t hash;              // HashROM of the contents, never zero
+    uint64_t pathHash;          // HashPath of the file last indexed
+    int64_t modified;           // That file's modification time
+    uint32_t size;              // Bytes in the ROM
+    Platform platform;
+    QuirkProfile quirks;        // Settings the frontend runs the ROM with
+    unsigned int cyclesPerFrame;
+    char keymap[NUM_KEYS];      // Keyboard keys for chip8 keys 0 to F, all zero for the default
+} CatalogEntry;
+
+// Which ROM a file held when it was last indexed, keyed by the file, so an
+// unchanged file is skipped without hashing it again. Any number of files may
+// hold the same ROM
+typedef struct CatalogPath
+{
+    uint64_t pathHash;          // HashPath of the file, never zero
+    uint64_t hash;              // HashROM of what it held
+    int64_t modified;           // Its modification time then
+    uint32_t size;              // Its size then
+} CatalogPath;
+
+// Catalogue files are two open-addressed hash tables, little-endian throughout,
+// so a lookup reads only the header and the slots it probes:
+//
+//   offset  size  field
+//        0     4  "C8IX"
+//        4     2  version
+//        6     2  reserved, zero
+//        8     4  slot count, a power of two
+//       12     4  slots in use
+//       16     4  path slot count, a power of two
+//       20     4  path slots in use
+//       24        slots of CATALOG_SLOT_SIZE bytes, each
+//                   0   8  hash, zero for an empty slot
+//                   8   8  pathHash
+//                  16   8  modified
+//                  24   4  size
+//                  28   1  platform
+//                  29   1  quirks
+//                  30   2  cyclesPerFrame
+//                  32  16  keymap
+//                 then path slots of CATALOG_PATH_SIZE bytes, each
+//                   0   8  pathHash, zero for an empty slot
+//                   8   8  hash
+//                  16   8  modified
+//                  24   4  size
+//                  28   4  reserved, zero
+//
+// A ROM's slot is its hash modulo the slot count, or the first empty slot after
+// it, and a file's path slot likewise by pathHash. At most half the slots of
+// either table are ever in use. Any change to the layout must bump
+// CATALOG_VERSION. Version 1 files still load: their header ended before the
+// path counts and they had no path slots, so each ROM's last file stands in
+#define CATALOG_MAGIC "C8IX"
+#define CATALOG_VERSION 2
+#define CATALOG_HEADER_SIZE 24
+#define CATALOG_SLOT_SIZE 48
+#define CATALOG_PATH_SIZE 32
+
+// A catalogue held in memory while it is being built
+typedef struct Catalog
+{
+    CatalogEntry *slots;    // Same layout as the file, hash zero when empty
+    uint32_t capacity;      // A power of two, or zero before the first entry
+    uint32_t count;
+    CatalogPath *paths;     // Likewise, pathHash zero when empty
+    uint32_t pathCapacity;
+    uint32_t pathCount;
+} Catalog;
+
+// 64-bit FNV-1a of a ROM's contents, or of a path string. Never zero
+uint64_t HashROM(const BYTE *rom, size_t size);
+uint64_t HashPath(const char *path);
+
+// Read a whole ROM file into rom, which holds capacity bytes. Returns non-zero
+// if the file can't be read or is larger than capacity
+int ReadROMFile(const char *path, BYTE *rom, size_t capacity, size_t *size);
+
+// Platform of the ROM, judged by the opcodes reachable from its entry point
+Platform DetectPlatform(const BYTE *rom, size_t size);
+const char *PlatformName(Platform platform);
+
+// Whether the first NUM_KEYS characters of layout are all keys the frontend can
+// map: letters of either case, digits, space and the unshifted punctuation keys
+// of a US keyboard
+int IsKeymap(const char *layout);
+
+// Fill in the settings a ROM of entry->platform starts with
+void DefaultSettings(CatalogEntry *entry);
+
+// Start an empty catalogue. Free it with FreeCatalog
+void InitCatalog(Catalog *catalog);
+void FreeCatalog(Catalog *catalog);
+
+// The entry for hash, or NULL
+CatalogEntry *FindEntry(const Catalog *catalog, uint64_t hash);
+
+// Insert an entry, or replace the one with the same hash. Returns non-zero when
+// out of memory
+int AddEntry(Catalog *catalog, const CatalogEntry *entry);
+
+// The same for files, keyed by pathHash
+CatalogPath *FindPath(const Catalog *catalog, uint64_t pathHash);
+int AddPath(Catalog *catalog, const CatalogPath *path);
+
+// Catalogue files. Return non-zero on I/O errors or a malformed file
+int SaveCatalog(const Catalog *catalog, const char *path);
+int LoadCatalog(Catalog *catalog, const char *path);
+
+// Find one ROM in a catalogue file without loading the rest. Returns non-zero
+// if the file can't be read or holds no entry for hash
+int LookupCatalog(const char *path, uint64_t hash, CatalogEntry *entry);
+
+#endif
@@ -0,0 +1,678 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chip8core.h"
+#include "lockstep.h"
+#include "fork.h"
+#include "movie.h"
+#include "aot.h"
+
+// Random programs each check runs, unless given on the command line
+#define DEFAULT_PROGRAMS 20000
+
+// Children forked from each parent in the fork check
+#define CHECK_FORKS 8
+
+// Frames each program runs for
+#define CHECK_FRAMES 40
+
+// Scratch file movies are written to and read back from
+#define MOVIE_PATH "chip8-check.c8mv"
+
+// Bytes at the start of a structured program built from idioms, see GenerateProgram
+#define STRUCTURED_SIZE 0x200
+
+// Offset of the first instruction an AOT check ROM rewrites, see GenerateAOTProgram
+#define AOT_PROLOGUE 8
+
+// Ways of running a program compared against the switch interpreter without
+// idle skipping. split runs each frame as several RunCycles calls of random
+// length, which puts instruction count boundaries everywhere
+static const struct
+{
+    const char *name;
+    Engine engine;
+    BYTE idleSkip;
+    BYTE split;
+} CONFIGS[] =
+{
+    { "cached", ENGINE_CACHED, 0, 0 },
+    { "jit", ENGINE_JIT, 0, 0 },
+
+    // Calls ending after any instruction, including the first of a fused pair
+    { "cached, split frames", ENGINE_CACHED, 0, 1 },
+    { "jit, split frames", ENGINE_JIT, 0, 1 },
+
+    // Fast-forwarding busy-wait loops must never change the outcome
+    { "switch, idle skipping", ENGINE_SWITCH, 1, 0 },
+    { "cached, idle skipping", ENGINE_CACHED, 1, 0 },
+    { "jit, idle skipping", ENGINE_JIT, 1, 0 },
+    { "cached, idle skipping, split frames", ENGINE_CACHED, 1, 1 },
+    { "jit, idle skipping, split frames", ENGINE_JIT, 1, 1 }
+};
+
+#define COUNT(array) (sizeof(array) / sizeof(array[0]))
+
+// xorshift64*, seeded the same every run so failures reproduce
+static uint64_t checkState = 0x9E3779B97F4A7C15ULL;
+
+static unsigned int Random(unsigned int range)
+{
+    checkState ^= checkState >> 12;
+    checkState ^= checkState << 25;
+    checkState ^= checkState >> 27;
+    return (checkState * 0x2545F4914F6CDD1DULL >> 32) % range;
+}
+
+static unsigned int Emit(BYTE *rom, unsigned int offset, WORD inst)
+{
+    rom[offset] = inst >> 8;
+    rom[offset + 1] = inst & 0xFF;
+    return offset + 2;
+}
+
+// Fill rom with a random program. Half are pure noise, which reaches every
+// opcode and plenty of self-modifying code. The rest start with the idioms real
+// ROMs are made of: loops polling the delay timer or a key, subroutine calls,
+// sprite draws and register setup, between random instructions
+static void GenerateProgram(BYTE *rom)
+{
+    unsigned int offset = 0;
+    unsigned int i;
+
+    for(i = 0; i < MAX_ROM_SIZE; ++i)
+        rom[i] = Random(0x100);
+    if(Random(2) == 0)
+        return;
+
+    while(offset < STRUCTURED_SIZE - 16)
+    {
+        WORD here = PROGRAM_START + offset;
+        WORD earlier = PROGRAM_START + 2 * Random(offset / 2 + 1);
+        WORD anywhere = PROGRAM_START + 2 * Random(STRUCTURED_SIZE / 2);
+        unsigned int x = Random(NUM_REGISTERS);
+        unsigned int y = Random(NUM_REGISTERS);
+
+        switch(Random(11))
+        {
+            // Set the delay timer and poll it down to zero
+            case 0:
+                offset = Emit(rom, offset, 0x6000 | x << 8 | Random(8));
+                offset = Emit(rom, offset, 0xF015 | x << 8);
+                offset = Emit(rom, offset, 0xF007 | x << 8);
+                offset = Emit(rom, offset, 0x3000 | x << 8);
+                offset = Emit(rom, offset, 0x1000 | (here + 4));
+                break;
+            // Spin until the key in Vx is down
+            case 1:
+                offset = Emit(rom, offset, 0xE09E | x << 8);
+                offset = Emit(rom, offset, 0x1000 | here);
+                break;
+            // Point I at a sprite and draw it
+            case 2:
+                offset = Emit(rom, offset, 0xA000 | anywhere);
+                offset = Emit(rom, offset, 0xD000 | x << 8 | y << 4 | Random(16));
+                break;
+            // Point I at a buffer and store to it or load from it
+            case 3:
+                offset = Emit(rom, offset, 0xA000 | (PROGRAM_START + STRUCTURED_SIZE + Random(0x100)));
+                offset = Emit(rom, offset, (0xF033 | x << 8) + (Random(3) == 0 ? 0 : Random(2) == 0 ? 0x22 : 0x32));
+                break;
+            // Register setup
+            case 4:
+                offset = Emit(rom, offset, 0x6000 | x << 8 | Random(0x100));
+                offset = Emit(rom, offset, 0x6000 | y << 8 | Random(0x100));
+                break;
+            // Subroutines, which return whenever one of the 00EEs below is reached
+            case 5:
+                offset = Emit(rom, offset, 0x2000 | anywhere);
+                break;
+            case 6:
+                offset = Emit(rom, offset, 0x00EE);
+                break;
+            // Loop back unless a register holds a value
+            case 7:
+                offset = Emit(rom, offset, 0x3000 | x << 8 | Random(4));
+                offset = Emit(rom, offset, 0x1000 | earlier);
+                break;
+            // Draw random numbers and throw them away until a key is down. Every
+            // pass looks the same but moves the generator on
+            case 8:
+                offset = Emit(rom, offset, 0xC000 | x << 8 | Random(0x100));
+                offset = Emit(rom, offset, 0x6000 | x << 8);
+                offset = Emit(rom, offset, 0xE09E | y << 8);
+                offset = Emit(rom, offset, 0x1000 | here);
+                break;
+            // Count passes in the user flags until a key is down. The registers
+            // are the same every pass, only the flags move on
+            case 9:
+                offset = Emit(rom, offset, 0xF085 | x << 8);
+                offset = Emit(rom, offset, 0x7001 | x << 8);
+                offset = Emit(rom, offset, 0xF075 | x << 8);
+                offset = Emit(rom, offset, 0x6000 | x << 8);
+                offset = Emit(rom, offset, 0xE09E | y << 8);
+                offset = Emit(rom, offset, 0x1000 | here);
+                break;
+            default:
+                offset = Emit(rom, offset, Random(0x10000));
+                break;
+        }
+    }
+}
+
+// Fill rom with a program for the AOT check. It starts by storing over the
+// instructions straight after it, which chip8-translate has already made into
+// a block, so the engine has to notice and interpret them instead
+static void GenerateAOTProgram(BYTE *rom)
+{
+    unsigned int offset = 0;
+    WORD inst;
+
+    GenerateProgram(rom);
+
+    inst = (rom[AOT_PROLOGUE] << 8 | rom[AOT_PROLOGUE + 1]) ^ (1 + Random(0xFFFF));
+    offset = Emit(rom, offset, 0x6000 | inst >> 8);
+    offset = Emit(rom, offset, 0x6100 | (inst & 0xFF));
+    offset = Emit(rom, offset, 0xA000 | (PROGRAM_START + AOT_PROLOGUE));
+    Emit(rom, offset, 0xF155);
+}
+
+// Write AOT check ROM number to path, for the check-aot target to translate
+static int WriteAOTProgram(unsigned long number, const char *path)
+{
+    static BYTE rom[MAX_ROM_SIZE];
+    FILE *output;
+
+    checkState = 0x9E3779B97F4A7C15ULL + number;
+    GenerateAOTProgram(rom);
+
+    if((output = fopen(path, "wb")) == NULL)
+    {
+        fprintf(stderr, "FILE I/O ERROR!\nCould not open file \"%s\".", path);
+        return -1;
+    }
+    if(fwrite(rom, 1, MAX_ROM_SIZE, output) != MAX_ROM_SIZE || fclose(output) != 0)
+    {
+        fprintf(stderr, "FILE I/O ERROR!\nCould not write \"%s\".", path);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Everything a program can observe or change about a machine
+static int SameMachine(const CHIP8 *a, const CHIP8 *b)
+{
+    return memcmp(a->mainMemory, b->mainMemory, MEMORY_SIZE) == 0 &&
+           memcmp(a->dataRegisters, b->dataRegisters, NUM_REGISTERS) == 0 &&
+           memcmp(a->screenRows, b->screenRows, sizeof(a->screenRows)) == 0 &&
+           memcmp(a->userFlags, b->userFlags, NUM_USER_FLAGS) == 0 &&
+           a->regI == b->regI && a->PC == b->PC && a->SP == b->SP &&
+           a->regDT == b->regDT && a->regST == b->regST &&
+           a->hires == b->hires && a->rngState == b->rngState;
+}
+
+// Boot a machine with rom, as the frontend does
+static void BootMachine(CHIP8 *cpu, const BYTE *rom, QuirkProfile quirks, uint64_t seed)
+{
+    memset(cpu, 0, sizeof(CHIP8));
+    memcpy(&cpu->mainMemory[PROGRAM_START], rom, MAX_ROM_SIZE);
+    InitializeCPU(cpu);
+    SeedRandom(cpu, seed);
+    cpu->quirks = quirks;
+}
+
+// One frame of cyclesPerFrame instructions, as one RunCycles call or several
+static void RunSplitFrame(CHIP8 *cpu, unsigned int cyclesPerFrame, int split)
+{
+    while(split && cyclesPerFrame > 0)
+    {
+        unsigned int count = 1 + Random(cyclesPerFrame < 8 ? cyclesPerFrame : 8);
+        RunCycles(cpu, count);
+        cyclesPerFrame -= count;
+    }
+    RunCycles(cpu, cyclesPerFrame);
+    StepTimers(cpu);
+}
+
+// Run every program under every configuration alongside the reference, with
+// the same keys pressed, comparing the machines after every frame
+static int CheckEngines(unsigned long programs)
+{
+    static BYTE rom[MAX_ROM_SIZE];
+    static CHIP8 reference, machine;
+    int failures = 0;
+    unsigned int c;
+
+    for(c = 0; c < COUNT(CONFIGS); ++c)
+    {
+        unsigned long program, skipped = 0;
+        int mismatches = 0;
+
+        checkState = 0x9E3779B97F4A7C15ULL + c;
+        for(program = 0; program < programs; ++program)
+        {
+            QuirkProfile quirks = program % (QUIRKS_XOCHIP + 1);
+            unsigned int cyclesPerFrame = 1 + Random(200);
+            WORD keys = 0;
+            int frame;
+
+            GenerateProgram(rom);
+            BootMachine(&reference, rom, quirks, program);
+            reference.idleSkip = 0;
+            BootMachine(&machine, rom, quirks, program);
+            machine.idleSkip = CONFIGS[c].idleSkip;
+            if(SetEngine(&machine, CONFIGS[c].engine) != 0)
+            {
+                printf("%s: unavailable on this host, skipped\n", CONFIGS[c].name);
+                break;
+            }
+
+            for(frame = 0; frame < CHECK_FRAMES; ++frame)
+            {
+                if(Random(4) == 0)
+                    keys ^= 1 << Random(NUM_KEYS);
+                SetKeyMask(&reference, keys);
+                SetKeyMask(&machine, keys);
+
+                RunFrame(&reference, cyclesPerFrame);
+                RunSplitFrame(&machine, cyclesPerFrame, CONFIGS[c].split);
+                if(!SameMachine(&reference, &machine))
+                {
+                    fprintf(stderr, "CHECK ERROR!\n%s differs from the switch interpreter on program %lu "
+                            "after frame %d (PC %03X, expected %03X).\n",
+                            CONFIGS[c].name, program, frame, machine.PC, reference.PC);
+                    ++mismatches;
+                    break;
+                }
+            }
+            skipped += machine.idleCycles;
+            ReleaseEngine(&machine);
+        }
+
+        if(program == programs)
+            printf("%s: %lu programs, %d mismatches, %lu instructions skipped as busy-waiting\n",
+                   CONFIGS[c].name, programs, mismatches, skipped);
+        failures += mismatches;
+    }
+
+    return failures;
+}
+
+#ifdef CHECK_AOT
+
+// The ROM this build was linked with, translated by chip8-translate
+extern const AOTProgram aotProgram;
+
+// Runs of the translated ROM per profile and configuration in the AOT check,
+// each with its own seed, frame length and keys
+#define AOT_RUNS 50
+
+// Ways of running it, as CONFIGS. The AOT engine only runs the ROM it was
+// built around, so it has configurations of its own
+static const struct
+{
+    const char *name;
+    BYTE idleSkip;
+    BYTE split;
+} AOT_CONFIGS[] =
+{
+    { "aot", 0, 0 },
+    { "aot, split frames", 0, 1 },
+    { "aot, idle skipping", 1, 0 },
+    { "aot, idle skipping, split frames", 1, 1 }
+};
+
+// Run the translated ROM under every profile and AOT configuration alongside
+// the reference, comparing the machines after every frame. Every configuration
+// must also have found the blocks the ROM rewrites and interpreted them
+static int CheckAOT(void)
+{
+    static CHIP8 reference, machine;
+    const BYTE *rom = &aotProgram.image[PROGRAM_START];
+    int failures = 0;
+    unsigned int c;
+
+    for(c = 0; c < COUNT(AOT_CONFIGS); ++c)
+    {
+        unsigned long run, rewritten = 0, skipped = 0;
+        int mismatches = 0;
+
+        checkState = 0x9E3779B97F4A7C15ULL + c;
+        for(run = 0; run < AOT_RUNS * QUIRK_PROFILES; ++run)
+        {
+            QuirkProfile quirks = run % QUIRK_PROFILES;
+            unsigned int cyclesPerFrame = 1 + Random(200);
+            WORD keys = 0;
+            int frame, differs = 0;
+
+            BootMachine(&reference, rom, quirks, run);
+            reference.idleSkip = 0;
+            BootMachine(&machine, rom, quirks, run);
+            machine.idleSkip = AOT_CONFIGS[c].idleSkip;
+            machine.aotProgram = &aotProgram;
+            if(SetEngine(&machine, ENGINE_AOT) != 0)
+            {
+                fprintf(stderr, "CHECK ERROR!\nCould not start the AOT engine.");
+                return failures + 1;
+            }
+
+            for(frame = 0; frame < CHECK_FRAMES; ++frame)
+            {
+                if(Random(4) == 0)
+                    keys ^= 1 << Random(NUM_KEYS);
+                SetKeyMask(&reference, keys);
+                SetKeyMask(&machine, keys);
+
+                RunFrame(&reference, cyclesPerFrame);
+                RunSplitFrame(&machine, cyclesPerFrame, AOT_CONFIGS[c].split);
+                if(!SameMachine(&reference, &machine))
+                {
+                    fprintf(stderr, "CHECK ERROR!\n%s differs from the switch interpreter on run %lu "
+                            "after frame %d (PC %03X, expected %03X).\n",
+                            AOT_CONFIGS[c].name, run, frame, machine.PC, reference.PC);
+                    ++mismatches;
+                    break;
+                }
+
+                // Later stores to code reset every block, so look after each frame
+                if(memchr(machine.aotCache->checked, AOT_DIFFERS, MEMORY_SIZE) != NULL)
+                    differs = 1;
+            }
+            rewritten += differs;
+            skipped += machine.idleCycles;
+            ReleaseEngine(&machine);
+        }
+
+        if(rewritten == 0)
+        {
+            fprintf(stderr, "CHECK ERROR!\n%s never found a rewritten block.\n", AOT_CONFIGS[c].name);
+            ++mismatches;
+        }
+
+        printf("%s: %lu runs, %d mismatches, %lu with rewritten blocks, %lu instructions skipped as busy-waiting\n",
+               AOT_CONFIGS[c].name, run, mismatches, rewritten, skipped);
+        failures += mismatches;
+    }
+
+    return failures;
+}
+
+#endif
+
+// Run each program in a lockstep group whose lanes have their own random seeds
+// and keys, so they branch apart and regroup, and check every lane against a
+// machine of its own run by RunCycles. Every other group runs its frames as
+// several RunLockstep calls
+static int CheckLockstep(unsigned long programs)
+{
+    static BYTE rom[MAX_ROM_SIZE];
+    static CHIP8 boot, lane, reference[LOCKSTEP_LANES];
+    unsigned long program, vectorSteps = 0, scalarSteps = 0;
+    int mismatches = 0;
+
+    checkState = 0xD1B54A32D192ED03ULL;
+    for(program = 0; program < programs; ++program)
+    {
+        unsigned int cyclesPerFrame = 1 + Random(200);
+        Lockstep *group;
+        unsigned int l;
+        int frame;
+
+        GenerateProgram(rom);
+        BootMachine(&boot, rom, program % (QUIRKS_XOCHIP + 1), program);
+        boot.idleSkip = 0;
+        if((group = CreateLockstep(&boot, LOCKSTEP_LANES)) == NULL)
+            return ++mismatches;
+
+        // Lanes share a seed in pairs, so some stay in step far longer than others
+        for(l = 0; l < LOCKSTEP_LANES; ++l)
+        {
+            reference[l] = boot;
+            SeedRandom(&reference[l], program * LOCKSTEP_LANES + l / 2);
+            LoadLane(group, l, &reference[l]);
+        }
+
+        for(frame = 0; frame < CHECK_FRAMES && mismatches == 0; ++frame)
+        {
+            unsigned int done = 0;
+
+            for(l = 0; l < LOCKSTEP_LANES; ++l)
+            {
+                if(Random(8) == 0)
+                    reference[l].inputKeys[Random(NUM_KEYS)] ^= 0xFF;
+                memcpy(group->machines[l].inputKeys, reference[l].inputKeys, NUM_KEYS);
+            }
+
+            while(program % 2 == 1 && cyclesPerFrame - done > 1)
+            {
+                unsigned int count = 1 + Random(cyclesPerFrame - done - 1);
+                RunLockstep(group, count);
+                done += count;
+            }
+            RunLockstepFrame(group, cyclesPerFrame - done);
+
+            for(l = 0; l < LOCKSTEP_LANES; ++l)
+            {
+                RunFrame(&reference[l], cyclesPerFrame);
+                StoreLane(group, l, &lane);
+                if(!SameMachine(&reference[l], &lane))
+                {
+                    fprintf(stderr, "CHECK ERROR!\nLockstep lane %u differs from RunCycles on program %lu "
+                            "after frame %d (PC %03X, expected %03X).\n",
+                            l, program, frame, lane.PC, reference[l].PC);
+                    ++mismatches;
+                    break;
+                }
+            }
+        }
+
+        vectorSteps += group->vectorSteps;
+        scalarSteps += group->scalarSteps;
+        DestroyLockstep(group);
+        if(mismatches != 0)
+            break;
+    }
+
+    printf("lockstep: %lu programs of %d lanes, %lu vector and %lu scalar steps, %d mismatches\n",
+           program, LOCKSTEP_LANES, vectorSteps, scalarSteps, mismatches);
+    return mismatches;
+}
+
+// Fork children from a booted parent and run them one after another on a single
+// runner machine, each with its own seed and keys, so they store to memory, draw
+// and change registers independently. Halfway through, the last child is
+// replaced by a copy of the first, which both then go on changing. Every child
+// must end as a machine of its own run from the parent would, and the parent
+// must be untouched
+static int CheckForks(unsigned long programs)
+{
+    static const Engine engines[] = { ENGINE_SWITCH, ENGINE_CACHED, ENGINE_JIT };
+    static BYTE rom[MAX_ROM_SIZE];
+    static CHIP8 parent, original, runner, reference[CHECK_FORKS];
+    static Fork children[CHECK_FORKS];
+    unsigned long program, pages = 0;
+    int mismatches = 0;
+
+    checkState = 0xBF58476D1CE4E5B9ULL;
+    for(program = 0; program < programs && mismatches == 0; ++program)
+    {
+        unsigned int cyclesPerFrame = 1 + Random(200);
+        ForkRunner forkRunner;
+        unsigned int k;
+        int frame;
+
+        GenerateProgram(rom);
+        BootMachine(&parent, rom, program % (QUIRKS_XOCHIP + 1), program);
+        parent.idleSkip = 0;
+        for(frame = 0; frame < CHECK_FRAMES / 4; ++frame)
+            RunFrame(&parent, cyclesPerFrame);
+        original = parent;
+
+        memset(&runner, 0, sizeof(CHIP8));
+        runner.idleSkip = 1;
+        if(SetEngine(&runner, engines[program % COUNT(engines)]) != 0)
+            SetEngine(&runner, ENGINE_SWITCH);
+        InitForkRunner(&forkRunner, &runner);
+
+        for(k = 0; k < CHECK_FORKS; ++k)
+        {
+            ForkMachine(&children[k], &parent);
+            children[k].rngState += k;
+            reference[k] = parent;
+            reference[k].rngState = children[k].rngState;
+        }
+
+        for(frame = 0; frame < CHECK_FRAMES; ++frame)
+        {
+            if(frame == CHECK_FRAMES / 2)
+            {
+                FreeFork(&children[CHECK_FORKS - 1]);
+                if(ForkChild(&children[CHECK_FORKS - 1], &children[0]) != 0)
+                    return ++mismatches;
+                reference[CHECK_FORKS - 1] = reference[0];
+            }
+
+            // A different order every frame, so the runner swaps between all sorts of children
+            for(k = 0; k < CHECK_FORKS; ++k)
+            {
+                unsigned int child = (k * 3 + frame) % CHECK_FORKS;
+
+                if(Random(4) == 0)
+                    reference[child].inputKeys[Random(NUM_KEYS)] ^= 0xFF;
+                memcpy(children[child].inputKeys, reference[child].inputKeys, NUM_KEYS);
+
+                SwapIn(&forkRunner, &children[child]);
+                RunFrame(&runner, cyclesPerFrame);
+                if(SwapOut(&forkRunner, &children[child]) != 0)
+                    return ++mismatches;
+                RunFrame(&reference[child], cyclesPerFrame);
+            }
+        }
+
+        for(k = 0; k < CHECK_FORKS; ++k)
+        {
+            SwapIn(&forkRunner, &children[k]);
+            if(!SameMachine(&reference[k], &runner))
+            {
+                fprintf(stderr, "CHECK ERROR!\nFork %u of program %lu differs from a machine run on its own "
+                        "(PC %03X, expected %03X).\n", k, program, runner.PC, reference[k].PC);
+                ++mismatches;
+            }
+            pages += (ForkFootprint(&children[k]) - sizeof(Fork)) / MEMORY_PAGE_SIZE;
+            FreeFork(&children[k]);
+        }
+        if(!SameMachine(&original, &parent))
+        {
+            fprintf(stderr, "CHECK ERROR!\nRunning the forks of program %lu changed their parent.\n", program);
+            ++mismatches;
+        }
+        ReleaseEngine(&runner);
+    }
+
+    printf("forks: %lu programs of %d children, %lu private pages, %d mismatches\n",
+           program, CHECK_FORKS, pages, mismatches);
+    return mismatches;
+}
+
+// Record each program being played with keys changing mid-frame, as the
+// frontend does, save the movie and load it back, then replay it on a fresh
+// machine with another engine. The replay must draw the same frames and end in
+// the same state as the recording
+static int CheckMovies(unsigned long programs)
+{
+    static const Engine engines[] = { ENGINE_SWITCH, ENGINE_CACHED, ENGINE_JIT };
+    static BYTE rom[MAX_ROM_SIZE];
+    static CHIP8 recorder, player;
+    unsigned long program, events = 0;
+    int mismatches = 0;
+
+    checkState = 0x2545F4914F6CDD1DULL;
+    for(program = 0; program < programs; ++program)
+    {
+        QuirkProfile quirks = program % (QUIRKS_XOCHIP + 1);
+        unsigned int cyclesPerFrame = 1 + Random(200);
+        Movie movie, loaded;
+        int frame;
+
+        GenerateProgram(rom);
+        BootMachine(&recorder, rom, quirks, program);
+        InitMovie(&movie, program, cyclesPerFrame, quirks);
+
+        for(frame = 0; frame < CHECK_FRAMES; ++frame)
+        {
+            unsigned int cycle = Random(cyclesPerFrame + 1);
+
+            RunCycles(&recorder, cycle);
+            if(Random(3) == 0)
+                recorder.inputKeys[Random(NUM_KEYS)] ^= 0xFF;
+            if(RecordKeys(&movie, &recorder, cycle) != 0)
+                return ++mismatches;
+            RunCycles(&recorder, cyclesPerFrame - cycle);
+            StepTimers(&recorder);
+            RecordFrame(&movie, &recorder);
+        }
+
+        if(SaveMovie(&movie, MOVIE_PATH) != 0 || LoadMovie(&loaded, MOVIE_PATH) != 0)
+        {
+            fprintf(stderr, "CHECK ERROR!\nCould not write and read back \"%s\".\n", MOVIE_PATH);
+            FreeMovie(&movie);
+            return ++mismatches;
+        }
+
+        // Everything but the ROM comes from the file
+        BootMachine(&player, rom, loaded.quirks, loaded.seed);
+        if(SetEngine(&player, engines[program % COUNT(engines)]) != 0)
+            SetEngine(&player, ENGINE_SWITCH);
+        if(ReplayMovie(&player, &loaded) != movie.screenHash || loaded.count != movie.count ||
+           !SameMachine(&recorder, &player))
+        {
+            fprintf(stderr, "CHECK ERROR!\nThe replay of program %lu diverged from its recording.\n", program);
+            ++mismatches;
+        }
+
+        events += movie.count;
+        ReleaseEngine(&player);
+        FreeMovie(&movie);
+        FreeMovie(&loaded);
+    }
+    remove(MOVIE_PATH);
+
+    printf("movies: %lu programs, %lu key events, %d mismatches\n", programs, events, mismatches);
+    return mismatches;
+}
+
+// Builds linked with a translated ROM under CHECK_AOT also take --aot, which
+// runs only the AOT check on that ROM
+int main(int argc, char **argv)
+{
+    unsigned long programs;
+    int failures = 0;
+
+    if(argc == 4 && strcmp(argv[1], "--rom") == 0)
+        return WriteAOTProgram(strtoul(argv[2], NULL, 0), argv[3]) != 0 ? -1 : 0;
+
+#ifdef CHECK_AOT
+    if(argc == 2 && strcmp(argv[1], "--aot") == 0)
+    {
+        failures = CheckAOT();
+        printf("%d failures\n", failures);
+        return failures != 0 ? 1 : 0;
+    }
+#endif
+
+    programs = argc > 1 ? strtoul(argv[1], NULL, 0) : DEFAULT_PROGRAMS;
+    if(argc > 2 || programs == 0)
+    {
+        fprintf(stderr, "USAGE ERROR!\nCorrect Usage: chip8-check [programs | --rom <number> <rom-file>].");
+        return -1;
+    }
+
+    failures += CheckEngines(programs);
+    failures += CheckLockstep(programs / 4);
+    failures += CheckForks(programs / 4);
+    failures += CheckMovies(programs);
+
+    printf("%d failures\n", failures);
+    return failures != 0 ? 1 : 0;
+}
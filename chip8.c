@@ -1,102 +1,446 @@
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include "chip8.h"
 
 int main(int argc, char **argv)
 {
-    WORD inst = 0;      // Current instruction for this cycle
-    long inputSize = 0; // Size of input ROM
+    CHIP8 cpu = {0};    // State of the emulated machine
+    Options options;    // Settings from the command line
 
     // Check for valid usage
-    if(argc != 3)
+    if(ParseArguments(argc, argv, &options) != 0)
     {
-        fprintf(stderr, "USAGE ERROR!\nCorrect Usage: chip8-emu <rom-file> <graphics-multiple>.");
+        fprintf(stderr, "USAGE ERROR!\nCorrect Usage: chip8-emu [--engine switch|cached|jit|aot] [--quirks modern|vip|chip48|schip|xochip] [--ipf <n>] [--seed <n>] [--no-idle-skip] [--load-state <file>] [--save-state <file>] [--rewind-mb <n>] [--audio-buffer <samples>] [--keymap <16 keys>] [--index <file>] [--record <file>] [--replay <file>] [--headless [--cycles <n>] [--frames <n>]] <rom-file> <graphics-multiple>.");
         return -1;
     }
     
     // Hiya there fella
 
-    // Open ROM file
-    FILE *input;
-    if((input = fopen(argv[1], "rb")) == NULL)
+    // Check for valid multiplier. A headless run has no window to scale
+    if(!options.headless && options.multiplier == 0)
     {
-        fprintf(stderr, "FILE I/O ERROR!\nCould not open file \"%s\".", argv[1]);
+        fprintf(stderr, "GRAPHICS ERROR!\n<graphics-multiple> must be a positive integer");
         return -1;
     }
+    const unsigned int MULTIPLIER = options.multiplier;
 
-    // Check for valid multiplier
-    if(atoi(argv[2]) <= 0)
+    // Read ROM into mainMemory. Anything bigger would run off the end of it
+    size_t romSize;
+    if(ReadROMFile(options.romPath, &cpu.mainMemory[PROGRAM_START], MAX_ROM_SIZE, &romSize) != 0)
     {
-        fprintf(stderr, "GRAPHICS ERROR!\n<graphics-multiple> must be a positive integer");
+        fprintf(stderr, "FILE I/O ERROR!\nCould not read \"%s\" as a chip8 ROM of at most %d bytes.", options.romPath, MAX_ROM_SIZE);
         return -1;
     }
-    const unsigned int MULTIPLIER = atoi(argv[2]);
 
-    // Obtain filesize
-    fseek(input, 0, SEEK_END);
-    inputSize = ftell(input);
-    rewind(input);
+    // The catalogue knows the ROM by its contents, whatever the file is called.
+    // Anything given on the command line wins over what it says
+    char catalogKeymap[NUM_KEYS + 1] = {0};
+    if(options.indexPath != NULL)
+    {
+        CatalogEntry entry;
+        if(LookupCatalog(options.indexPath, HashROM(&cpu.mainMemory[PROGRAM_START], romSize), &entry) != 0)
+            fprintf(stderr, "CATALOG ERROR!\n\"%s\" is not in \"%s\", running with the default settings.\n", options.romPath, options.indexPath);
+        else
+        {
+            if(!(options.explicitSettings & SETTING_QUIRKS))
+                options.quirks = entry.quirks;
+            if(!(options.explicitSettings & SETTING_IPF))
+                options.limits.cyclesPerFrame = entry.cyclesPerFrame;
+            memcpy(catalogKeymap, entry.keymap, NUM_KEYS);
+            if(!(options.explicitSettings & SETTING_KEYMAP) && catalogKeymap[0] != '\0')
+                options.keymap = catalogKeymap;
+        }
+    }
 
-    // Read ROM into mainMemory
-    fread(&mainMemory[PROGRAM_START], inputSize, 1, input);
-    fclose(input);
+    // A replay brings its own seed, frame length and quirks. Anything else may be recorded
+    Movie movie;
+    if(options.replayPath != NULL)
+    {
+        if(LoadMovie(&movie, options.replayPath) != 0)
+        {
+            fprintf(stderr, "MOVIE ERROR!\nCould not load \"%s\".", options.replayPath);
+            return -1;
+        }
+        options.seed = movie.seed;
+        options.limits.cyclesPerFrame = movie.cyclesPerFrame;
+        if(movie.quirks >= 0 && movie.quirks != (int)options.quirks && (options.explicitSettings & SETTING_QUIRKS))
+            fprintf(stderr, "MOVIE ERROR!\n\"%s\" was recorded with the %s quirks, replaying with them rather than %s.\n",
+                    options.replayPath, QuirkProfileName(movie.quirks), QuirkProfileName(options.quirks));
+        if(movie.quirks >= 0)
+            options.quirks = movie.quirks;
+    }
+    else
+        InitMovie(&movie, options.seed, options.limits.cyclesPerFrame, options.quirks);
+
+    InitializeCPU(&cpu);
+    SeedRandom(&cpu, options.seed);
+    cpu.idleSkip = options.idleSkip;
+    cpu.quirks = options.quirks;
+#ifdef CHIP8_AOT
+    cpu.aotProgram = &aotProgram;
+#endif
+    if(SetEngine(&cpu, options.engine) != 0)
+    {
+        fprintf(stderr, "ENGINE ERROR!\nCould not set up the requested interpreter.");
+        return -1;
+    }
 
-    // Seed random number generator
-    srand(time(NULL));
+    // Start from a checkpoint rather than power-on
+    if(options.loadStatePath != NULL && LoadStateFile(&cpu, options.loadStatePath) != 0)
+    {
+        fprintf(stderr, "SAVE STATE ERROR!\nCould not load \"%s\".", options.loadStatePath);
+        return -1;
+    }
+    if(options.loadStatePath != NULL && cpu.quirks != options.quirks && (options.explicitSettings & SETTING_QUIRKS))
+        fprintf(stderr, "SAVE STATE ERROR!\n\"%s\" was saved with the %s quirks, running with them rather than %s.\n",
+                options.loadStatePath, QuirkProfileName(cpu.quirks), QuirkProfileName(options.quirks));
+
+    // Headless runs never touch SDL. Run to the limit and report the final state
+    if(options.headless)
+    {
+#ifdef CHIP8_PROFILE
+        if((cpu.profile = CreateProfile(CLOCKS_PER_SEC)) == NULL)
+            fprintf(stderr, "PROFILE ERROR!\nCould not allocate profile counters.\n");
+#endif
+
+        clock_t start = clock();
+        unsigned long cycles;
+        uint64_t hash = 0;
+        if(options.replayPath != NULL)
+        {
+            hash = ReplayMovie(&cpu, &movie);
+            cycles = movie.frames * movie.cyclesPerFrame;
+        }
+        else
+            cycles = RunHeadless(&cpu, &options.limits);
+        double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        DumpScreen(&cpu, stdout);
+        DumpRegisters(&cpu, stdout);
+        fprintf(stderr, "%lu instructions in %.3f s", cycles, seconds);
+        if(seconds > 0)
+            fprintf(stderr, " (%.0f instructions/s)", cycles / seconds);
+        if(cpu.idleCycles > 0)
+            fprintf(stderr, ", %lu skipped as busy-waiting", cpu.idleCycles);
+        fputc('\n', stderr);
+
+        if(options.saveStatePath != NULL && SaveStateFile(&cpu, options.saveStatePath) != 0)
+            fprintf(stderr, "SAVE STATE ERROR!\nCould not save \"%s\".", options.saveStatePath);
+
+#ifdef CHIP8_PROFILE
+        if(cpu.profile != NULL)
+            DumpProfile(cpu.profile, stderr);
+        DestroyProfile(cpu.profile);
+#endif
+        ReleaseEngine(&cpu);
+
+        // A replay must have drawn exactly what was recorded, frame for frame
+        if(options.replayPath != NULL && hash != movie.screenHash)
+        {
+            fprintf(stderr, "REPLAY ERROR!\nThe screen diverged from the recording in \"%s\".", options.replayPath);
+            FreeMovie(&movie);
+            return -1;
+        }
+        FreeMovie(&movie);
+        return 0;
+    }
 
     SDL_Window *window = NULL;      // Window rendered to
     SDL_Renderer *renderer = NULL;  // Used to render textures
-    Mix_Chunk *beep = NULL;         // Stores the beep effect
+    SDL_Texture *texture = NULL;    // Streaming copy of screenRows
+    Audio audio;                    // Beeps while the sound timer runs
 
     // Non-zero return indicates unrecoverable SDL initialization error. Abort
-    if(InitializeSDL(&window, &renderer, &beep, MULTIPLIER) != 0)
+    if(InitializeSDL(&window, &renderer, &texture, MULTIPLIER) != 0)
         return -1;
 
-    int quit = 0;       // Continue execution until the user quits
-    SDL_Event event;    // Represents user input
+    // Running silent is not fatal
+    if(OpenAudio(&audio, options.audioBuffer) != 0)
+        fprintf(stderr, "SDL ERROR!\nAudio was not initialized: %s", SDL_GetError());
+
+    int quit = 0;           // Continue execution until the user quits
+    SDL_Event event;        // Represents user input
+
+    // Physical keys are looked up by scancode, so the layout is the same
+    // whatever the host keyboard's language
+    BYTE keymap[SDL_NUM_SCANCODES];
+    if(BuildKeymap(keymap, options.keymap) != 0)
+    {
+        fprintf(stderr, "INPUT ERROR!\nKeymap \"%s\" names a key this keyboard lacks.", options.keymap);
+        return -1;
+    }
+
+    // Key transitions wait here, stamped with SDL's event time, until the frame
+    // they fall in runs. Each is applied at the instruction matching its time
+    static InputQueue keyQueue;
+    InitInputQueue(&keyQueue);
+    Uint32 lastPoll = SDL_GetTicks();
+
+    // F5 and F9 save and load here. Without a path on the command line the
+    // state lives next to the ROM
+    char defaultStatePath[FILENAME_MAX];
+    const char *statePath = options.saveStatePath != NULL ? options.saveStatePath : options.loadStatePath;
+    if(statePath == NULL)
+    {
+        snprintf(defaultStatePath, sizeof(defaultStatePath), "%s.state", options.romPath);
+        statePath = defaultStatePath;
+    }
 
-    InitializeCPU();
+    // Frame history for rewinding. Running without it is not fatal. Recordings
+    // must only move forward, so they get no history
+    Rewind *history = NULL;
+    if(options.recordPath == NULL && options.rewindBudget > 0 && (history = CreateRewind(options.rewindBudget)) == NULL)
+        fprintf(stderr, "REWIND ERROR!\nCould not allocate %lu bytes of history.\n", (unsigned long)options.rewindBudget);
 
-    // Begin countdown registers
-    SDL_TimerID timerID = SDL_AddTimer(17, DecrementTimers, beep);
+#ifdef CHIP8_PROFILE
+    if((cpu.profile = CreateProfile(SDL_GetPerformanceFrequency())) == NULL)
+        fprintf(stderr, "PROFILE ERROR!\nCould not allocate profile counters.\n");
+    Uint64 mark = SDL_GetPerformanceCounter();  // Start of the phase being timed
+#endif
 
-    // Main Loop. One iteration represents a single chip8 cycle
+    // Frames are scheduled against the high resolution counter so rounding
+    // errors never accumulate
+    const Uint64 FRAME_TICKS = SDL_GetPerformanceFrequency() / TIMER_HZ;
+    Uint64 nextFrame = SDL_GetPerformanceCounter() + FRAME_TICKS;
+
+    // Main Loop. One iteration represents a single 60Hz frame
     while(!quit)
     {
+        // Everything up to now belongs to the frame about to run
+        Uint32 poll = SDL_GetTicks();
+
         //Handle events on queue
         while(SDL_PollEvent(&event) != 0)
         {
-            CheckForInput(event);
+            CheckForInput(&keyQueue, keymap, event);
 
             //User requests quit
             if(event.type == SDL_QUIT )
                 quit = 1;
+
+            // Save state hotkeys
+            if(event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F5 &&
+               SaveStateFile(&cpu, statePath) != 0)
+                fprintf(stderr, "SAVE STATE ERROR!\nCould not save \"%s\".\n", statePath);
+            if(event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F9 &&
+               options.recordPath == NULL && LoadStateFile(&cpu, statePath) != 0)
+                fprintf(stderr, "SAVE STATE ERROR!\nCould not load \"%s\".\n", statePath);
+
+#ifdef CHIP8_PROFILE
+            // Report so far without stopping
+            if(event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F12 && cpu.profile != NULL)
+                DumpProfile(cpu.profile, stderr);
+#endif
+        }
+        PROFILE_LAP(&cpu, PHASE_EVENTS, mark);
+
+        // Holding backspace steps back a frame instead of running one. The keys
+        // held right now are kept rather than the ones recorded with the frame
+        if(history != NULL && SDL_GetKeyboardState(NULL)[SDL_SCANCODE_BACKSPACE])
+        {
+            BYTE keys[NUM_KEYS];
+            memcpy(keys, cpu.inputKeys, NUM_KEYS);
+            RewindFrame(history, &cpu);
+            memcpy(cpu.inputKeys, keys, NUM_KEYS);
+            DrainKeys(&cpu, &keyQueue);
+        }
+        else
+        {
+            // Execute this frame's instructions with the keys changing as they
+            // did over the last frame's time, then tick the timers in this thread.
+            // A recording logs each change with the instruction it landed on
+            if(RunQueuedFrame(&cpu, options.limits.cyclesPerFrame, &keyQueue, lastPoll, poll,
+                              options.recordPath != NULL ? &movie : NULL) != 0)
+            {
+                fprintf(stderr, "MOVIE ERROR!\nOut of memory while recording.");
+                return -1;
+            }
+            if(history != NULL)
+                CaptureFrame(history, &cpu);
+            if(options.recordPath != NULL)
+                RecordFrame(&movie, &cpu);
         }
+        lastPoll = poll;
+        PROFILE_LAP(&cpu, PHASE_EXECUTE, mark);
 
-        // Fetch and execute inst, affecting cpu state
-        inst = Fetch();
-        DecodeExecute(inst);
+        // The tone plays for as long as the sound timer has left to run
+        UpdateAudio(&audio, cpu.regST);
 
         // Draw new graphics based on changed state
-        if(Draw(&window, &renderer) != 0)
+        if(cpu.screenDirty && Draw(&renderer, texture, &cpu) != 0)
             return -1;
+        PROFILE_LAP(&cpu, PHASE_DRAW, mark);
+
+        // Sleep away the rest of the frame. After a stall, resynchronize rather
+        // than running frames back to back to catch up
+        WaitUntil(nextFrame);
+        nextFrame += FRAME_TICKS;
+        if(SDL_GetPerformanceCounter() > nextFrame)
+            nextFrame = SDL_GetPerformanceCounter() + FRAME_TICKS;
+        PROFILE_LAP(&cpu, PHASE_WAIT, mark);
+        PROFILE_END_FRAME(&cpu);
     }
 
+#ifdef CHIP8_PROFILE
+    if(cpu.profile != NULL)
+        DumpProfile(cpu.profile, stderr);
+    DestroyProfile(cpu.profile);
+#endif
+    DestroyRewind(history);
+    ReleaseEngine(&cpu);
+
+    if(options.recordPath != NULL && SaveMovie(&movie, options.recordPath) != 0)
+        fprintf(stderr, "MOVIE ERROR!\nCould not save \"%s\".", options.recordPath);
+    FreeMovie(&movie);
+
     // SDL cleanup
-    SDL_RemoveTimer(timerID);
-    Mix_FreeChunk(beep);
+    CloseAudio(&audio);
+    SDL_DestroyTexture(texture);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
 
     return 0;
 }
 
+// Fill options from the command line. Returns non-zero on malformed usage
+int ParseArguments(int argc, char **argv, Options *options)
+{
+    int i;
+    int positional = 0;
+
+    options->romPath = NULL;
+    options->multiplier = 0;
+    options->headless = 0;
+    options->engine = DEFAULT_ENGINE;
+    options->idleSkip = 1;
+    options->loadStatePath = NULL;
+    options->saveStatePath = NULL;
+    options->rewindBudget = DEFAULT_REWIND_MB << 20;
+    options->recordPath = NULL;
+    options->seed = time(NULL);
+    options->replayPath = NULL;
+    options->audioBuffer = DEFAULT_AUDIO_BUFFER;
+    options->keymap = DEFAULT_KEYMAP;
+    options->quirks = QUIRKS_MODERN;
+    options->limits.maxCycles = 0;
+    options->limits.maxFrames = 0;
+    options->limits.cyclesPerFrame = CYCLES_PER_FRAME;
+    options->indexPath = NULL;
+    options->explicitSettings = 0;
+
+    for(i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "--headless") == 0)
+            options->headless = 1;
+        else if(strcmp(argv[i], "--engine") == 0 && i + 1 < argc)
+        {
+            ++i;
+            if(strcmp(argv[i], "switch") == 0)
+                options->engine = ENGINE_SWITCH;
+            else if(strcmp(argv[i], "cached") == 0)
+                options->engine = ENGINE_CACHED;
+            else if(strcmp(argv[i], "jit") == 0)
+                options->engine = ENGINE_JIT;
+#ifdef CHIP8_AOT
+            else if(strcmp(argv[i], "aot") == 0)
+                options->engine = ENGINE_AOT;
+#endif
+            else
+                return -1;
+        }
+        else if(strcmp(argv[i], "--no-idle-skip") == 0)
+            options->idleSkip = 0;
+        else if(strcmp(argv[i], "--load-state") == 0 && i + 1 < argc)
+            options->loadStatePath = argv[++i];
+        else if(strcmp(argv[i], "--save-state") == 0 && i + 1 < argc)
+            options->saveStatePath = argv[++i];
+        else if(strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            options->seed = strtoull(argv[++i], NULL, 0);
+        else if(strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            options->recordPath = argv[++i];
+        else if(strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+        {
+            // Replays always run headless, for as many frames as were recorded
+            options->replayPath = argv[++i];
+            options->headless = 1;
+        }
+        else if(strcmp(argv[i], "--audio-buffer") == 0 && i + 1 < argc)
+        {
+            // SDL wants a power of two that fits its 16-bit sample count
+            options->audioBuffer = strtoul(argv[++i], NULL, 0);
+            if(options->audioBuffer == 0 || options->audioBuffer > 0x8000 ||
+               (options->audioBuffer & (options->audioBuffer - 1)) != 0)
+                return -1;
+        }
+        else if(strcmp(argv[i], "--quirks") == 0 && i + 1 < argc)
+        {
+            int quirks = FindQuirkProfile(argv[++i]);
+            if(quirks < 0)
+                return -1;
+            options->quirks = quirks;
+            options->explicitSettings |= SETTING_QUIRKS;
+        }
+        else if(strcmp(argv[i], "--keymap") == 0 && i + 1 < argc)
+        {
+            options->keymap = argv[++i];
+            if(strlen(options->keymap) != NUM_KEYS)
+                return -1;
+            options->explicitSettings |= SETTING_KEYMAP;
+        }
+        else if(strcmp(argv[i], "--index") == 0 && i + 1 < argc)
+            options->indexPath = argv[++i];
+        else if(strcmp(argv[i], "--rewind-mb") == 0 && i + 1 < argc)
+            options->rewindBudget = (size_t)strtoul(argv[++i], NULL, 0) << 20;
+        else if(strcmp(argv[i], "--ipf") == 0 && i + 1 < argc)
+        {
+            options->limits.cyclesPerFrame = strtoul(argv[++i], NULL, 0);
+            if(options->limits.cyclesPerFrame == 0)
+                return -1;
+            options->explicitSettings |= SETTING_IPF;
+        }
+        else if(strcmp(argv[i], "--cycles") == 0 && i + 1 < argc)
+            options->limits.maxCycles = strtoul(argv[++i], NULL, 0);
+        else if(strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            options->limits.maxFrames = strtoul(argv[++i], NULL, 0);
+        else if(argv[i][0] == '-' && argv[i][1] == '-')
+            return -1;
+        else if(positional == 0)
+        {
+            options->romPath = argv[i];
+            ++positional;
+        }
+        else if(positional == 1)
+        {
+            options->multiplier = atoi(argv[i]) > 0 ? atoi(argv[i]) : 0;
+            ++positional;
+        }
+        else
+            return -1;
+    }
+
+    if(options->romPath == NULL)
+        return -1;
+
+    // Only interactive sessions have input to record
+    if(options->recordPath != NULL && options->headless)
+        return -1;
+
+    // Interactive runs need a window size, headless runs need an end
+    if(options->replayPath != NULL)
+        return 0;
+    if(options->headless)
+        return options->limits.maxCycles == 0 && options->limits.maxFrames == 0 ? -1 : 0;
+    return positional == 2 ? 0 : -1;
+}
+
 // General SDL plumbing...
-int InitializeSDL(SDL_Window **window, SDL_Renderer **renderer, Mix_Chunk **beep, const unsigned int MULTIPLIER)
+int InitializeSDL(SDL_Window **window, SDL_Renderer **renderer, SDL_Texture **texture, const unsigned int MULTIPLIER)
 {
     // Initialize SDL
-    if(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_AUDIO) < 0)
+    if(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0)
     {
         fprintf(stderr, "SDL ERROR!\nCould not initialize: %s", SDL_GetError());
         return -1;
@@ -122,761 +466,114 @@ int InitializeSDL(SDL_Window **window, SDL_Renderer **renderer, Mix_Chunk **beep
                 return -1;
             }
             SDL_SetRenderDrawColor(*renderer, 0xFF, 0xFF, 0xFF, 0xFF);
+
+            // Create the one texture the screen is streamed into for the life of the window.
+            // It is sized for high resolution, and low resolution uses its top left corner
+            *texture = SDL_CreateTexture(*renderer, SDL_PIXELFORMAT_ARGB8888,
+                       SDL_TEXTUREACCESS_STREAMING, HIRES_WIDTH, HIRES_HEIGHT);
+            if(*texture == NULL)
+            {
+                fprintf(stderr, "SDL ERROR!\nTexture could not be created: %s", SDL_GetError());
+                return -1;
+            }
         }
     }
 
-    // Initialize SDL_mixer extension
-    if(Mix_OpenAudio(22050, MIX_DEFAULT_FORMAT, 2, 4096) == -1)
-        fprintf(stderr, "SDL ERROR!\nAudio was not initialized: %s", SDL_GetError());
-
-    // Load beep sound effect
-    *beep = Mix_LoadWAV("beep.wav");
-    if(*beep == NULL)
-        fprintf(stderr, "SDL ERROR!\nCouldn't load audio file: %s", SDL_GetError());
-    
     return 0;
 }
 
-// Set CPU constructs to appropriate values for initial execution
-void InitializeCPU()
+// Look up the physical key behind each character of layout, which lists the
+// keyboard keys for chip8 keys 0 to F in order. Returns non-zero if one of them
+// isn't a key IsKeymap allows, so the indexer rejects the same layouts, or isn't
+// on this keyboard
+int BuildKeymap(BYTE *keymap, const char *layout)
 {
     int i;
 
-    // Zero out all registers
-    regI = 0x000;
-    regDT = 0x000;
-    regST = 0x000;
-    for(i = 0; i < NUM_REGISTERS; ++i)
-        dataRegisters[i] = 0x00;
-
-    // Initialize pointers to appropriate values
-    PC = PROGRAM_START;
-    SP = STACK_START;
+    if(!IsKeymap(layout))
+        return -1;
 
-    // Initialize stock hexadecimal sprites
-    InitNumericalSprites();
-    
-    // Initialize all keys to be unpressed
+    memset(keymap, KEY_UNMAPPED, SDL_NUM_SCANCODES);
     for(i = 0; i < NUM_KEYS; ++i)
-        inputKeys[i] = 0x00;
-}
-
-// Write hard-coded stock sprites into reserved section of memory. Each sprite
-// represents a hexadecimal digit.
-void InitNumericalSprites()
-{
-    // The sprite 0
-    mainMemory[0x000] = 0xF0;
-    mainMemory[0x001] = 0x90;
-    mainMemory[0x002] = 0x90;
-    mainMemory[0x003] = 0x90;
-    mainMemory[0x004] = 0xF0;
-
-    // The sprite 1
-    mainMemory[0x005] = 0x20;
-    mainMemory[0x006] = 0x60;
-    mainMemory[0x007] = 0x20;
-    mainMemory[0x008] = 0x20;
-    mainMemory[0x009] = 0x70;
-
-    // The sprite 2
-    // mainMemory[0x00A] = 0xF0;
-    // mainMemory[0x00B] = 0x10;
-    // mainMemory[0x00C] = 0xF0;
-    // mainMemory[0x00D] = 0x80;
-    // mainMemory[0x00E] = 0xF0;
-
-    // The sprite 3
-    mainMemory[0x00F] = 0xF0;
-    mainMemory[0x010] = 0x10;
-    mainMemory[0x011] = 0xF0;
-    mainMemory[0x012] = 0x10;
-    mainMemory[0x013] = 0xF0;
-
-    // The sprite 4
-    mainMemory[0x014] = 0x90;
-    mainMemory[0x015] = 0x90;
-    mainMemory[0x016] = 0xF0;
-    mainMemory[0x017] = 0x10;
-    mainMemory[0x018] = 0x10;
-
-    // The sprite 5
-    mainMemory[0x019] = 0xF0;
-    mainMemory[0x01A] = 0x80;
-    mainMemory[0x01B] = 0xF0;
-    mainMemory[0x01C] = 0x10;
-    mainMemory[0x01D] = 0xF0;
-
-    // The sprite 6
-    mainMemory[0x01E] = 0xF0;
-    mainMemory[0x01F] = 0x80;
-    mainMemory[0x020] = 0xF0;
-    mainMemory[0x021] = 0x90;
-    mainMemory[0x022] = 0xF0;
-
-    // The sprite 7
-    mainMemory[0x023] = 0xF0;
-    mainMemory[0x024] = 0x10;
-    mainMemory[0x025] = 0x20;
-    mainMemory[0x026] = 0x40;
-    mainMemory[0x027] = 0x40;
-
-    // The sprite 8
-    mainMemory[0x028] = 0xF0;
-    mainMemory[0x029] = 0x90;
-    mainMemory[0x02A] = 0xF0;
-    mainMemory[0x02B] = 0x90;
-    mainMemory[0x02C] = 0xF0;
-
-    // The sprite 9
-    mainMemory[0x02D] = 0xF0;
-    mainMemory[0x02E] = 0x90;
-    mainMemory[0x02F] = 0xF0;
-    mainMemory[0x030] = 0x10;
-    mainMemory[0x031] = 0xF0;
-
-    // The sprite A
-    mainMemory[0x032] = 0xF0;
-    mainMemory[0x033] = 0x90;
-    mainMemory[0x034] = 0xF0;
-    mainMemory[0x035] = 0x90;
-    mainMemory[0x036] = 0x90;
-
-    // The sprite B
-    mainMemory[0x037] = 0xE0;
-    mainMemory[0x038] = 0x90;
-    mainMemory[0x039] = 0xE0;
-    mainMemory[0x03A] = 0x90;
-    mainMemory[0x03B] = 0xE0;
-
-    // The sprite C
-    mainMemory[0x03C] = 0xF0;
-    mainMemory[0x03D] = 0x80;
-    mainMemory[0x03E] = 0x80;
-    mainMemory[0x03F] = 0x80;
-    mainMemory[0x040] = 0xF0;
-
-    // The sprite D
-    mainMemory[0x041] = 0xE0;
-    mainMemory[0x042] = 0x90;
-    mainMemory[0x043] = 0x90;
-    mainMemory[0x044] = 0x90;
-    mainMemory[0x045] = 0xE0;
-
-    // The sprite E
-    mainMemory[0x046] = 0xF0;
-    mainMemory[0x047] = 0x80;
-    mainMemory[0x048] = 0xF0;
-    mainMemory[0x049] = 0x80;
-    mainMemory[0x04A] = 0xF0;
-
-    // The sprite F
-    mainMemory[0x04B] = 0xF0;
-    mainMemory[0x04C] = 0x80;
-    mainMemory[0x04D] = 0xF0;
-    mainMemory[0x04E] = 0x80;
-    mainMemory[0x04F] = 0x80;
-}
-
-// Check parameter event for keyboard input from user
-void CheckForInput(SDL_Event event)
-{
-    // If a key is pressed...
-    if(event.type == SDL_KEYDOWN)
-    {
-        // ...find out which key and...
-        int key = -1 ;
-        switch(event.key.keysym.sym)
-        {
-            case SDLK_x: key = 0;  break;
-            case SDLK_1: key = 1;  break;
-            case SDLK_2: key = 2;  break;
-            case SDLK_3: key = 3;  break;
-            case SDLK_q: key = 4;  break;
-            case SDLK_w: key = 5;  break;
-            case SDLK_e: key = 6;  break;
-            case SDLK_a: key = 7;  break;
-            case SDLK_s: key = 8;  break;
-            case SDLK_d: key = 9;  break;
-            case SDLK_z: key = 10; break;
-            case SDLK_c: key = 11; break;
-            case SDLK_4: key = 12; break;
-            case SDLK_r: key = 13; break;
-            case SDLK_f: key = 14; break;
-            case SDLK_v: key = 15; break;
-            default: break;
-        }
-        if (key != -1)
-        {
-            // ...activate that key
-            inputKeys[key] = 0xFF;
-        }
-    }
-    // If a key is released...
-    else if(event.type == SDL_KEYUP)
     {
-        // ...find out which key and...
-        int key = -1 ;
-        switch(event.key.keysym.sym)
-        {
-            case SDLK_x: key = 0;  break;
-            case SDLK_1: key = 1;  break;
-            case SDLK_2: key = 2;  break;
-            case SDLK_3: key = 3;  break;
-            case SDLK_q: key = 4;  break;
-            case SDLK_w: key = 5;  break;
-            case SDLK_e: key = 6;  break;
-            case SDLK_a: key = 7;  break;
-            case SDLK_s: key = 8;  break;
-            case SDLK_d: key = 9;  break;
-            case SDLK_z: key = 10; break;
-            case SDLK_c: key = 11; break;
-            case SDLK_4: key = 12; break;
-            case SDLK_r: key = 13; break;
-            case SDLK_f: key = 14; break;
-            case SDLK_v: key = 15; break;
-            default: break;
-        }
-        if (key != -1)
-        {
-            // ... deactivate that key
-            inputKeys[key] = 0x00;
-        }
-    }
-}
-
-// Draw graphics to screen using data stored in screenData
-int Draw(SDL_Window **window, SDL_Renderer **renderer)
-{
-    // New surface created from data in screenData
-    SDL_Surface *graphics = SDL_CreateRGBSurfaceFrom(
-        (void *)screenData,
-        SCREEN_WIDTH,
-        SCREEN_HEIGHT,
-        CHANNELS * 8,
-        SCREEN_WIDTH * CHANNELS,
-        0x0000FF,
-        0x00FF00,
-        0xFF0000,
-        0x000000
-    );
-
-    // Create texture from graphics
-    SDL_Texture *texture = SDL_CreateTextureFromSurface(*renderer, graphics);
-    if(texture == NULL)
-    {
-        fprintf(stderr, "SDL ERROR!\nTexture could not be created: %s", SDL_GetError());
-        return -1;
+        SDL_Scancode code = SDL_GetScancodeFromKey(tolower((unsigned char)layout[i]));
+        if(code == SDL_SCANCODE_UNKNOWN)
+            return -1;
+        keymap[code] = i;
     }
 
-    // Render texture
-    SDL_RenderClear(*renderer);
-    SDL_RenderCopy(*renderer, texture, NULL, NULL);
-    SDL_RenderPresent(*renderer);
-
-    // Free SDL resources
-    SDL_FreeSurface(graphics);
-    SDL_DestroyTexture(texture);
-
     return 0;
 }
 
-// Callback function for SDL_Timer. Executes once for each interval
-Uint32 DecrementTimers(Uint32 interval, void *param)
-{
-    // Decrement delay and sound registers
-    if(regDT > 0)
-        --regDT;
-    if(regST > 0)
-        --regST;
-    
-    // If sound regsiter is positive, play beep
-    if(regST > 0)
-        Mix_PlayChannel(-1, (Mix_Chunk *)param, 0);
-
-    // This function is called again after this interval has elapsed
-    return interval;
-}
-
-// Fetch the next instruction for execution
-WORD Fetch()
-{
-    // Bitwise logic is necessary because memory is indexed by BYTE and an instruction
-    // is a WORD (two BYTES)
-    WORD inst = mainMemory[PC++];
-    inst <<= 8;
-    inst |= mainMemory[PC++];
-
-    return inst;
-}
-
-// Calls the correct execute function for a given instruction or the correct decode
-// function for a set of possible instructions
-void DecodeExecute(WORD inst)
-{
-    switch(inst & 0xF000)
-    {
-        case 0x0000: Decode0000(inst);  break;
-        case 0x1000: Execute1NNN(inst); break;
-        case 0x2000: Execute2NNN(inst); break;
-        case 0x3000: Execute3XNN(inst); break;
-        case 0x4000: Execute4XNN(inst); break;
-        case 0x5000: Execute5XY0(inst); break;
-        case 0x6000: Execute6XNN(inst); break;
-        case 0x7000: Execute7XNN(inst); break;
-        case 0x8000: Decode8000(inst);  break;
-        case 0x9000: Execute9XY0(inst); break;
-        case 0xA000: ExecuteANNN(inst); break;
-        case 0xB000: ExecuteBNNN(inst); break;
-        case 0xC000: ExecuteCXNN(inst); break;
-        case 0xD000: ExecuteDXYN(inst); break;
-        case 0xE000: DecodeE000(inst);  break;
-        case 0xF000: DecodeF000(inst);  break;
-        default: break;
-    }
-}
-
-// Calls the correct execution function for a given instruction that begins with 0
-void Decode0000(WORD inst)
+// Queue the key transition in event, if it is one. Keys outside the keymap and
+// auto-repeats are ignored
+void CheckForInput(InputQueue *queue, const BYTE *keymap, SDL_Event event)
 {
-    switch(inst)
+    if((event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) && !event.key.repeat)
     {
-        case 0x00E0: Execute00E0(); break;
-        case 0x00EE: Execute00EE(); break;
-        default:     Execute0NNN(inst); break;
+        BYTE key = keymap[event.key.keysym.scancode];
+        if(key != KEY_UNMAPPED)
+            PushKey(queue, event.key.timestamp, key, event.type == SDL_KEYDOWN);
     }
 }
 
-// Calls the correct execution function for a given instruction that begins with 8
-void Decode8000(WORD inst)
+// Draw graphics to screen using data stored in screenRows
+int Draw(SDL_Renderer **renderer, SDL_Texture *texture, CHIP8 *cpu)
 {
-    switch(inst & 0x000F)
-    {
-        case 0x0000: Execute8XY0(inst); break;
-        case 0x0001: Execute8XY1(inst); break;
-        case 0x0002: Execute8XY2(inst); break;
-        case 0x0003: Execute8XY3(inst); break;
-        case 0x0004: Execute8XY4(inst); break;
-        case 0x0005: Execute8XY5(inst); break;
-        case 0x0006: Execute8XY6(inst); break;
-        case 0x0007: Execute8XY7(inst); break;
-        case 0x000E: Execute8XYE(inst); break;
-        default: break;
-    }
-}
+    SDL_Rect area = { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
+    void *pixels;
+    int pitch, x, y;
 
-// Calls the correct execution function for a given instruction that begins with E
-void DecodeE000(WORD inst)
-{
-    switch(inst & 0xF0FF)
+    if(cpu->hires)
     {
-        case 0xE09E: ExecuteEX9E(inst); break;
-        case 0xE0A1: ExecuteEXA1(inst); break;
-        default: break;
+        area.w = HIRES_WIDTH;
+        area.h = HIRES_HEIGHT;
     }
-}
 
-// Calls the correct execution function for a given instruction that begins with F
-void DecodeF000(WORD inst)
-{
-    switch(inst & 0x00FF)
+    // Expand the bit-packed rows straight into the part of the persistent
+    // streaming texture the current resolution covers
+    if(SDL_LockTexture(texture, &area, &pixels, &pitch) != 0)
     {
-        case 0x0007: ExecuteFX07(inst); break;
-        case 0x000A: ExecuteFX0A(inst); break;
-        case 0x0015: ExecuteFX15(inst); break;
-        case 0x0018: ExecuteFX18(inst); break;
-        case 0x001E: ExecuteFX1E(inst); break;
-        case 0x0029: ExecuteFX29(inst); break;
-        case 0x0033: ExecuteFX33(inst); break;
-        case 0x0055: ExecuteFX55(inst); break;
-        case 0x0065: ExecuteFX65(inst); break;
-        default: break;
-    }
-}
-
-// 00E0 - CLS : Clear the screen
-void Execute00E0()
-{
-    for(int y = 0; y < SCREEN_HEIGHT; ++y) 
-    {
-        for(int x = 0; x < SCREEN_WIDTH; ++x)
-        {
-            screenData[y][x][0] = 0xFF;
-            screenData[y][x][1] = 0xFF;
-            screenData[y][x][2] = 0xFF;
-        }
+        fprintf(stderr, "SDL ERROR!\nTexture could not be locked: %s", SDL_GetError());
+        return -1;
     }
-}
-
-// 00EE - RET : Return from subroutine
-void Execute00EE()
-{
-    // Memory is indexed by BYTE so fetch both BYTES of the WORD in memory at SP
-    WORD lo = mainMemory[--SP];
-    WORD hi = mainMemory[--SP] << 8; 
-    PC = lo | hi;
-}
-
-// 0NNN - SYS addr : Jump to machine code routine at NNN
-void Execute0NNN(WORD inst)
-{
-    // This is only necessary in actual hardware
-}
-
-// 1NNN - JP addr : Jump to location NNN
-void Execute1NNN(WORD inst)
-{
-    PC = inst & 0x0FFF;
-}
-
-// 2NNN - CALL addr : Call subroutine at NNN
-void Execute2NNN(WORD inst)
-{
-    // Memory is indexed by BYTE so store both BYTES of the WORD in memory at SP
-    mainMemory[SP++] = (PC & 0xFF00) >> 8;
-    mainMemory[SP++] = PC & 0x00FF;
-    PC = inst & 0x0FFF;
-}
-
-// 3XNN - SE Vx, NN : Skip next instruction if Vx == NN
-void Execute3XNN(WORD inst)
-{
-    unsigned int x = (inst & 0x0F00) >> 8;
-    int n = inst & 0x00FF;
-
-    if(dataRegisters[x] == n)
-        PC += 2;
-}
-
-// 4XNN - SNE Vx, NN : Skip next instruction if Vx != NN
-void Execute4XNN(WORD inst)
-{
-    unsigned int x = (inst & 0x0F00) >> 8;
-    int n = inst & 0x00FF;
-
-    if(dataRegisters[x] != n)
-        PC += 2;
-}
-
-// 5XY0 - SE Vx, Vy : Skip next instruction if Vx == Vy
-void Execute5XY0(WORD inst)
-{
-    unsigned int x = (inst & 0x0F00) >> 8;
-    unsigned int y = (inst & 0x00F0) >> 4;
-
-    if(dataRegisters[x] == dataRegisters[y])
-        PC += 2;
-}
-
-// 6XNN - LD Vx, NN : Load NN into Vx (Vx == NN)
-void Execute6XNN(WORD inst)
-{
-    unsigned int x = (inst & 0x0F00) >> 8;
-    dataRegisters[x] = inst & 0x00FF;
-}
-
-// 7XNN - ADD Vx, NN : Add NN to Vx and store result into Vx
-void Execute7XNN(WORD inst)
-{
-    unsigned int x = (inst & 0x0F00) >> 8;
-    int n = inst & 0x00FF;
-
-    dataRegisters[x] += n;
-}
-
-// 8XY0 - LD Vx, Vy : Load Vy into Vx (Vx == Vy)
-void Execute8XY0(WORD inst)
-{
-    unsigned int x = (inst & 0x0F00) >> 8;
-    unsigned int y = (inst & 0x00F0) >> 4;
-
-    dataRegisters[x] = dataRegisters[y];
-}
-
-// 8XY1 - OR Vx, Vy : Bitwise or Vx and Vy and store result into Vx
-void Execute8XY1(WORD inst)
-{
-    unsigned int x = (inst & 0x0F00) >> 8;
-    unsigned int y = (inst & 0x00F0) >> 4;
-
-    dataRegisters[x] |= dataRegisters[y];
-}
-
-// 8XY2 - AND Vx, Vy : Bitwise and Vx and Vy and store result into Vx
-void Execute8XY2(WORD inst)
-{
-    unsigned int x = (inst & 0x0F00) >> 8;
-    unsigned int y = (inst & 0x00F0) >> 4;
-
-    dataRegisters[x] &= dataRegisters[y];
-}
-
-// 8XY3 - XOR Vx, Vy : Bitwise xor Vx and Vy and store result into Vx
-void Execute8XY3(WORD inst)
-{
-    unsigned int x = (inst & 0x0F00) >> 8;
-    unsigned int y = (inst & 0x00F0) >> 4;
-
-    dataRegisters[x] ^= dataRegisters[y];
-}
-
-// 8XY4 - ADD Vx, Vy : Add Vx and Vy and store result into Vx
-void Execute8XY4(WORD inst)
-{
-    unsigned int x = (inst & 0x0F00) >> 8;
-    unsigned int y = (inst & 0x00F0) >> 4;
-
-    // Check for carry and set VF appropriately
-    WORD check = dataRegisters[x] + dataRegisters[y];
-    if(check > 0xFF)
-        dataRegisters[0xF] = 1;
-    else
-        dataRegisters[0xF] = 0;
-
-    dataRegisters[x] += dataRegisters[y];
-}
-
-// 8XY5 - SUB Vx, Vy : Subtract Vy from Vx and store result into Vx
-void Execute8XY5(WORD inst)
-{
-    unsigned int x = (inst & 0x0F00) >> 8;
-    unsigned int y = (inst & 0x00F0) >> 4;
-
-    // Check for borrow and set VF appropriately
-    if(dataRegisters[x] > dataRegisters[y])
-        dataRegisters[0xF] = 1;
-    else
-        dataRegisters[0xF] = 0;
-
-    dataRegisters[x] = dataRegisters[x] - dataRegisters[y];
-}
-
-// 8XY6 - SHR Vx {, Vy} : Set Vx to Vx >> 1
-void Execute8XY6(WORD inst)
-{
-    unsigned int x = (inst & 0x0F00) >> 8;
-
-    // Set VF to the least significant bit of Vx
-    dataRegisters[0xF] = dataRegisters[x] << 7 >> 7;
-
-    dataRegisters[x] >>= 1;
-}
-
-// 8XY7 - SUBN Vx, Vy : Subtract Vx from Vy and store result into Vx
-void Execute8XY7(WORD inst)
-{
-    unsigned int x = (inst & 0x0F00) >> 8;
-    unsigned int y = (inst & 0x00F0) >> 4;
-
-    // Check for borrow and set VF appropriately
-    if(dataRegisters[y] > dataRegisters[x])
-        dataRegisters[0xF] = 1;
-    else
-        dataRegisters[0xF] = 0;
-
-    dataRegisters[x] = dataRegisters[y] - dataRegisters[x];
-}
-
-// 8XY6 - SHL Vx {, Vy} : Set Vx to Vx << 1
-void Execute8XYE(WORD inst)
-{
-    unsigned int x = (inst & 0x0F00) >> 8;
-
-    // Set VF to the least significant bit of Vx
-    dataRegisters[0xF] = dataRegisters[x] >> 7;
-
-    dataRegisters[x] <<= 1;
-}
-
-// 9XY0 - SNE Vx, Vy : Skip next instruction if Vx != Vy
-void Execute9XY0(WORD inst)
-{
-    unsigned int x = (inst & 0x0F00) >> 8;
-    unsigned int y = (inst & 0x00F0) >> 4;
-
-    if(dataRegisters[x] != dataRegisters[y])
-        PC += 2;
-}
-
-// ANNN - LD I, addr : Set regI to NNN
-void ExecuteANNN(WORD inst)
-{
-    regI = inst & 0x0FFF;
-}
-
-// BNNN - JP V0, addr : Jump to address NNN + V0
-void ExecuteBNNN(WORD inst)
-{
-    int n = inst & 0x0FFF;
-    PC = n + dataRegisters[0];
-}
-
-// CXNN - RND Vx, NN : Set Vx to random BYTE & NN
-void ExecuteCXNN(WORD inst)
-{
-    unsigned int x = (inst & 0x0F00) >> 8;
-    int n = inst & 0x00FF;
-
-    dataRegisters[x] = (rand() % 256) & n;
-}
-
-// DXYN - DRW Vx, Vy, N : Draw N BYTE sprite from memory at regI to screen data starting
-// at position Vx, Vy
-void ExecuteDXYN(WORD inst)
-{
-    unsigned int regX = (inst & 0x0F00) >> 8;
-    unsigned int regY = (inst & 0x00F0) >> 4;
-    unsigned int startX = dataRegisters[regX];
-    unsigned int startY = dataRegisters[regY];
-    unsigned int height = inst & 0x000F;
-
-    int line, pixelPos, mask, x, y;
-    int drawColorR, drawColorG, drawColorB;
-    dataRegisters[0xF] = 0;
-
-    // For each horizontal line in the sprite (where height == N)...
-    for(line = 0; line < height; ++line)
+    for(y = 0; y < area.h; ++y)
     {
-        // Load sprite data from memory
-        BYTE data = mainMemory[regI + line];
+        Uint32 *row = (Uint32 *)((BYTE *)pixels + y * pitch);
 
-        // For each pixel in the horizontal line...
-        for(pixelPos = 0; pixelPos < SPRITE_WIDTH; ++pixelPos)
+        // High resolution rows continue into the word HIRES_HEIGHT further on
+        for(x = 0; x < area.w; x += 64)
         {
-            mask = 1 << (SPRITE_WIDTH - pixelPos - 1);
+            uint64_t bits = cpu->screenRows[y + (x / 64) * HIRES_HEIGHT];
+            int i;
 
-            // If a pixel should be flipped
-            if ((data & mask) != 0x00)
-            {
-                // Determine position to be fliped
-                x = startX + pixelPos;
-                y = startY + line;
-                drawColorR = drawColorG = drawColorB = 0x00;
-
-                // If a pixel is to be erased
-                if(screenData[y][x][0] == 0x00 &&
-                   screenData[y][x][1] == 0x00 &&
-                   screenData[y][x][2] == 0x00)
-                {
-                    // Set VF and change color to erase pixel
-                    dataRegisters[0xF] = 1;
-                    drawColorR = drawColorG = drawColorB = 0xFF;
-                }
-
-                // Draw pixel to screen
-                screenData[y][x][0] = drawColorR;
-                screenData[y][x][1] = drawColorG;
-                screenData[y][x][2] = drawColorB;
-            }
+            for(i = 0; i < 64; ++i, bits <<= 1)
+                row[x + i] = bits >> 63 ? PIXEL_LIT : PIXEL_UNLIT;
         }
     }
-}
-
-// EX9E - SKP Vx : Skip next instruction if key Vx is pressed
-void ExecuteEX9E(WORD inst)
-{
-    unsigned int x = (inst & 0x0F00) >> 8;
-    unsigned int keyIndex = dataRegisters[x];
-
-    if(inputKeys[keyIndex] == 0xFF)
-        PC += 2;
-}
-
-// EXA1 = SKNP Vx : Skip next instruction if key VX is NOT pressed
-void ExecuteEXA1(WORD inst)
-{
-    unsigned int x = (inst & 0x0F00) >> 8;
-    unsigned int keyIndex = dataRegisters[x];
+    SDL_UnlockTexture(texture);
+    cpu->screenDirty = 0;
 
-    if(inputKeys[keyIndex] == 0x00)
-        PC += 2;
-}
+    // Render texture, stretching the covered part over the whole window
+    SDL_RenderClear(*renderer);
+    SDL_RenderCopy(*renderer, texture, &area, NULL);
+    SDL_RenderPresent(*renderer);
 
-// FX07 - LD Vx, DT : Set Vx to the value of the delay timer
-void ExecuteFX07(WORD inst)
-{
-    unsigned int x = (inst & 0x0F00) >> 8;
-    dataRegisters[x] = regDT;
+    return 0;
 }
 
-// FX0A - LD Vx, K : Load Vx with the key that was pressed
-void ExecuteFX0A(WORD inst)
+// Block until the performance counter reaches deadline. SDL_Delay covers most
+// of the wait, and the last couple of milliseconds are spun for precision
+void WaitUntil(Uint64 deadline)
 {
-    unsigned int x = (inst & 0x0F00) >> 8;
-    int i;
+    const Uint64 FREQUENCY = SDL_GetPerformanceFrequency();
+    Uint64 now = SDL_GetPerformanceCounter();
 
-    int key = -1;
-    for(i = 0; i < NUM_KEYS; ++i)
+    while(now < deadline)
     {
-        if(inputKeys[i] == 0xFF)
-            key = i;
+        Uint64 remainingMs = (deadline - now) * 1000 / FREQUENCY;
+        if(remainingMs > 2)
+            SDL_Delay(remainingMs - 2);
+        now = SDL_GetPerformanceCounter();
     }
-
-    // This is a blocking operation. Repeat until a key is pressed
-    if(key == -1)
-        PC -= 2;
-    else
-        dataRegisters[x] = key;
-}
-
-// FX15 - LD DT, Vx : Set the delay timer to the value of Vx
-void ExecuteFX15(WORD inst)
-{
-    unsigned int x = (inst & 0x0F00) >> 8;
-    regDT = dataRegisters[x];
-}
-
-// FX18 - LD ST, Vx : Set the sound timer to the value of Vx
-void ExecuteFX18(WORD inst)
-{
-    unsigned int x = (inst & 0x0F00) >> 8;
-    regST = dataRegisters[x];
-}
-
-// FX1E - ADD I, Vx : Set regI to itself plus the value of Vx
-void ExecuteFX1E(WORD inst)
-{
-    unsigned int x = (inst & 0x0F00) >> 8;
-    regI = regI + dataRegisters[x];
-}
-
-// FX29 - LD F, Vx : Set regI to the location for the hex sprite in Vx
-void ExecuteFX29(WORD inst)
-{
-    unsigned int x = (inst & 0x0F00) >> 8;
-    regI = mainMemory[dataRegisters[x] * 5];
-}
-
-// FX33 - LD B, Vx : Store a decimal representation of Vx in memory at regI to regI + 2
-void ExecuteFX33(WORD inst)
-{
-    unsigned int x = (inst & 0x0F00) >> 8;
-
-    int hundreds = dataRegisters[x] / 100;
-    int tens = (dataRegisters[x] % 100) / 10;
-    int ones = dataRegisters[x] % 10;
-
-    mainMemory[regI] = hundreds;
-    mainMemory[regI + 1] = tens;
-    mainMemory[regI + 2] = ones;
 }
-
-// FX55 - LD [I], Vx : Store registers V0 through Vx into memory at regI
-void ExecuteFX55(WORD inst)
-{
-    unsigned int x = (inst & 0x0F00) >> 8;
-    int i;
-    
-    for(i = 0; i <= x; ++i)
-        mainMemory[regI + i] = dataRegisters[i];
-}
-
-// FX65 - LD Vx, [I] : Load registers V0 through Vx from memory at regI
-void ExecuteFX65(WORD inst)
-{
-    unsigned int x = (inst & 0x0F00) >> 8;
-    int i;
-
-    for(i = 0; i <= x; ++i)
-        dataRegisters[i] = mainMemory[regI + i];
-}
\ No newline at end of file
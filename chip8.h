@@ -1,95 +1,95 @@
 #include <SDL2/SDL.h>
-#include <SDL2/SDL_mixer.h>
+#include "chip8core.h"
+#include "headless.h"
+#include "profile.h"
+#include "savestate.h"
+#include "rewind.h"
+#include "movie.h"
+#include "audio.h"
+#include "input.h"
+#include "aot.h"
+#include "catalog.h"
 
-typedef unsigned char BYTE;
-typedef unsigned short WORD;
+// Colors a screen pixel is expanded to when presented
+#define PIXEL_LIT 0xFF000000
+#define PIXEL_UNLIT 0xFFFFFFFF
 
-// CPU constants
-#define MEMORY_SIZE 0xFFF
-#define STACK_START 0xEA0
-#define PROGRAM_START 0x200
-#define NUM_REGISTERS 16
-#define NUM_KEYS 16
+// Keyboard keys for chip8 keys 0 to F, laid out as the original hex keypad
+//   1 2 3 4        1 2 3 C
+//   q w e r   ->   4 5 6 D
+//   a s d f        7 8 9 E
+//   z x c v        A 0 B F
+#define DEFAULT_KEYMAP "x123qweasdzc4rfv"
 
-// Graphics constants
-#define SCREEN_WIDTH 64
-#define SCREEN_HEIGHT 32
-#define CHANNELS 3
-#define SPRITE_WIDTH 8
+// Marks scancodes no chip8 key is mapped to
+#define KEY_UNMAPPED 0xFF
 
-// Program should reside in 0x200 - 0xE9F inclusive
-BYTE mainMemory[MEMORY_SIZE];
+// Builds made with "make aot" carry one ROM translated to C, see aot.h. Its blocks
+// only run while memory still holds that ROM, so any other ROM works too
+#ifdef CHIP8_AOT
+extern const AOTProgram aotProgram;
+#define DEFAULT_ENGINE ENGINE_AOT
+#else
+#define DEFAULT_ENGINE ENGINE_SWITCH
+#endif
 
-// Main general purpose registers with the exception of 0xF
-// 0xF is used for flags
-BYTE dataRegisters[NUM_REGISTERS];
+// Rewind history kept by default, about ten minutes of a typical game
+#define DEFAULT_REWIND_MB 4
 
-// Represents the current status of input keys
-// 0xFF is pressed, 0x00 is unpressed
-BYTE inputKeys[NUM_KEYS];
+// Frame phase timing for the profiler, see profile.h
+#ifdef CHIP8_PROFILE
+#define PROFILE_LAP(cpu, phase, mark)                                                   \
+    do                                                                                  \
+    {                                                                                   \
+        if((cpu)->profile != NULL)                                                      \
+            ProfileLap((cpu)->profile, (phase), &(mark), SDL_GetPerformanceCounter());  \
+    } while(0)
+#define PROFILE_END_FRAME(cpu)                  \
+    do                                          \
+    {                                           \
+        if((cpu)->profile != NULL)              \
+            ProfileEndFrame((cpu)->profile);    \
+    } while(0)
+#else
+#define PROFILE_LAP(cpu, phase, mark) ((void)0)
+#define PROFILE_END_FRAME(cpu) ((void)0)
+#endif
 
-BYTE regDT; // Delay Timer
-BYTE regST; // Sound Timer
-WORD regI;  // Address register
-WORD PC;    // Program counter
-WORD SP;    // Stack pointer
+// Settings given on the command line, which a ROM catalogue entry doesn't override
+#define SETTING_QUIRKS 0x01
+#define SETTING_IPF 0x02
+#define SETTING_KEYMAP 0x04
 
-// 3D array of bytes representing the data on the screen at any given time
-BYTE screenData[SCREEN_HEIGHT][SCREEN_WIDTH][CHANNELS];
+// Settings gathered from the command line
+typedef struct Options
+{
+    const char *romPath;        // ROM file to load
+    unsigned int multiplier;    // Window scale, unused when headless
+    Engine engine;              // Interpreter to run the ROM with
+    int idleSkip;               // Fast-forward busy-wait loops, see IdleSkip
+    int headless;               // Run without SDL, see headless.h
+    const char *loadStatePath;  // Save state to start from instead of power-on
+    const char *saveStatePath;  // Written at the end of a headless run, F5/F9 target otherwise
+    size_t rewindBudget;        // Bytes of rewind history, zero disables rewinding
+    const char *recordPath;     // Movie file the session's input is recorded to
+    const char *replayPath;     // Movie file to replay headless and verify
+    uint64_t seed;              // Random seed, the time unless given
+    unsigned int audioBuffer;   // Samples per audio callback, a power of two
+    const char *keymap;         // Keyboard keys for chip8 keys 0 to F, see DEFAULT_KEYMAP
+    QuirkProfile quirks;        // Semantics the ROM expects, see quirks.h
+    HeadlessOptions limits;     // Instructions per frame, and when a headless run stops
+    const char *indexPath;      // ROM catalogue to take the ROM's settings from, see catalog.h
+    unsigned int explicitSettings;  // SETTING_* flags for settings given on the command line
+} Options;
 
-// SDL plumbing stuff...
-int InitializeSDL(SDL_Window **window, SDL_Renderer **renderer, Mix_Chunk **beep, const unsigned int MULTIPLIER);
-
-// Helper functions for CPU
-void InitializeCPU();
-void InitNumericalSprites();
-void CheckForInput(SDL_Event event);
-int Draw(SDL_Window **window, SDL_Renderer **renderer);
-Uint32 DecrementTimers(Uint32 interval, void *param);
+// Command line handling
+int ParseArguments(int argc, char **argv, Options *options);
 
-// Implement CPU execution. All the work is done here
-WORD Fetch();
-void DecodeExecute(WORD inst);
-
-// These ensure the correct execute function is called for a given instruction
-void Decode0000(WORD inst);
-void Decode8000(WORD inst);
-void DecodeE000(WORD inst);
-void DecodeF000(WORD inst);
+// SDL plumbing stuff...
+int InitializeSDL(SDL_Window **window, SDL_Renderer **renderer, SDL_Texture **texture, const unsigned int MULTIPLIER);
 
-// Emulate the execution for the given instruction
-void Execute00E0();
-void Execute00EE();
-void Execute0NNN(WORD inst);
-void Execute1NNN(WORD inst);
-void Execute2NNN(WORD inst);
-void Execute3XNN(WORD inst);
-void Execute4XNN(WORD inst);
-void Execute5XY0(WORD inst);
-void Execute6XNN(WORD inst);
-void Execute7XNN(WORD inst);
-void Execute8XY0(WORD inst);
-void Execute8XY1(WORD inst);
-void Execute8XY2(WORD inst);
-void Execute8XY3(WORD inst);
-void Execute8XY4(WORD inst);
-void Execute8XY5(WORD inst);
-void Execute8XY6(WORD inst);
-void Execute8XY7(WORD inst);
-void Execute8XYE(WORD inst);
-void Execute9XY0(WORD inst);
-void ExecuteANNN(WORD inst);
-void ExecuteBNNN(WORD inst);
-void ExecuteCXNN(WORD inst);
-void ExecuteDXYN(WORD inst);
-void ExecuteEX9E(WORD inst);
-void ExecuteEXA1(WORD inst);
-void ExecuteFX07(WORD inst);
-void ExecuteFX0A(WORD inst);
-void ExecuteFX15(WORD inst);
-void ExecuteFX18(WORD inst);
-void ExecuteFX1E(WORD inst);
-void ExecuteFX29(WORD inst);
-void ExecuteFX33(WORD inst);
-void ExecuteFX55(WORD inst);
-void ExecuteFX65(WORD inst);
\ No newline at end of file
+// Helper functions for the SDL frontend
+int BuildKeymap(BYTE *keymap, const char *layout);
+void CheckForInput(InputQueue *queue, const BYTE *keymap, SDL_Event event);
+int Draw(SDL_Renderer **renderer, SDL_Texture *texture, CHIP8 *cpu);
+void WaitUntil(Uint64 deadline);
\ No newline at end of file
@@ -0,0 +1,1043 @@
+#include <stdlib.h>
+#include <string.h>
+#include "chip8core.h"
+#include "cache.h"
+#include "jit.h"
+#include "aot.h"
+#include "profile.h"
+#include "quirks.h"
+
+// Every store to mainMemory goes through here so decoded or translated
+// instructions never go stale. Addresses wrap at the top of memory
+static inline void StoreByte(CHIP8 *cpu, WORD addr, BYTE value)
+{
+    addr &= ADDRESS_MASK;
+    cpu->mainMemory[addr] = value;
+    ++cpu->writeCount;
+    cpu->dirtyPages |= 1 << (addr / MEMORY_PAGE_SIZE);
+    if(cpu->decodeCache != NULL)
+        InvalidateDecoded(cpu->decodeCache, addr);
+    if(cpu->jitCache != NULL)
+        InvalidateJIT(cpu->jitCache, addr);
+    if(cpu->aotCache != NULL)
+        InvalidateAOT(cpu->aotCache, addr);
+}
+
+// Set CPU constructs to appropriate values for initial execution
+void InitializeCPU(CHIP8 *cpu)
+{
+    int i;
+
+    // Zero out all registers
+    cpu->regI = 0x000;
+    cpu->regDT = 0x000;
+    cpu->regST = 0x000;
+    for(i = 0; i < NUM_REGISTERS; ++i)
+        cpu->dataRegisters[i] = 0x00;
+
+    // Initialize pointers to appropriate values
+    cpu->PC = PROGRAM_START;
+    cpu->SP = STACK_START;
+
+    // Initialize stock hexadecimal sprites
+    InitNumericalSprites(cpu);
+    InitLargeSprites(cpu);
+    
+    // Initialize all keys to be unpressed
+    for(i = 0; i < NUM_KEYS; ++i)
+        cpu->inputKeys[i] = 0x00;
+
+    // A fixed default keeps runs reproducible until the frontend picks a seed
+    SeedRandom(cpu, 0);
+
+    // Fast-forwarding busy-wait loops is invisible to the program, so it is on
+    // unless the frontend turns it off
+    cpu->idleSkip = 1;
+}
+
+// Seeds are scrambled with one SplitMix64 step, so nearby seeds give unrelated
+// sequences and no seed leaves xorshift stuck at zero
+void SeedRandom(CHIP8 *cpu, uint64_t seed)
+{
+    uint64_t z = seed + 0x9E3779B97F4A7C15ULL;
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    cpu->rngState = z != 0 ? z : 1;
+}
+
+// Write hard-coded stock sprites into reserved section of memory. Each sprite
+// represents a hexadecimal digit.
+void InitNumericalSprites(CHIP8 *cpu)
+{
+    // The sprite 0
+    cpu->mainMemory[0x000] = 0xF0;
+    cpu->mainMemory[0x001] = 0x90;
+    cpu->mainMemory[0x002] = 0x90;
+    cpu->mainMemory[0x003] = 0x90;
+    cpu->mainMemory[0x004] = 0xF0;
+
+    // The sprite 1
+    cpu->mainMemory[0x005] = 0x20;
+    cpu->mainMemory[0x006] = 0x60;
+    cpu->mainMemory[0x007] = 0x20;
+    cpu->mainMemory[0x008] = 0x20;
+    cpu->mainMemory[0x009] = 0x70;
+
+    // The sprite 2
+    // mainMemory[0x00A] = 0xF0;
+    // mainMemory[0x00B] = 0x10;
+    // mainMemory[0x00C] = 0xF0;
+    // mainMemory[0x00D] = 0x80;
+    // mainMemory[0x00E] = 0xF0;
+
+    // The sprite 3
+    cpu->mainMemory[0x00F] = 0xF0;
+    cpu->mainMemory[0x010] = 0x10;
+    cpu->mainMemory[0x011] = 0xF0;
+    cpu->mainMemory[0x012] = 0x10;
+    cpu->mainMemory[0x013] = 0xF0;
+
+    // The sprite 4
+    cpu->mainMemory[0x014] = 0x90;
+    cpu->mainMemory[0x015] = 0x90;
+    cpu->mainMemory[0x016] = 0xF0;
+    cpu->mainMemory[0x017] = 0x10;
+    cpu->mainMemory[0x018] = 0x10;
+
+    // The sprite 5
+    cpu->mainMemory[0x019] = 0xF0;
+    cpu->mainMemory[0x01A] = 0x80;
+    cpu->mainMemory[0x01B] = 0xF0;
+    cpu->mainMemory[0x01C] = 0x10;
+    cpu->mainMemory[0x01D] = 0xF0;
+
+    // The sprite 6
+    cpu->mainMemory[0x01E] = 0xF0;
+    cpu->mainMemory[0x01F] = 0x80;
+    cpu->mainMemory[0x020] = 0xF0;
+    cpu->mainMemory[0x021] = 0x90;
+    cpu->mainMemory[0x022] = 0xF0;
+
+    // The sprite 7
+    cpu->mainMemory[0x023] = 0xF0;
+    cpu->mainMemory[0x024] = 0x10;
+    cpu->mainMemory[0x025] = 0x20;
+    cpu->mainMemory[0x026] = 0x40;
+    cpu->mainMemory[0x027] = 0x40;
+
+    // The sprite 8
+    cpu->mainMemory[0x028] = 0xF0;
+    cpu->mainMemory[0x029] = 0x90;
+    cpu->mainMemory[0x02A] = 0xF0;
+    cpu->mainMemory[0x02B] = 0x90;
+    cpu->mainMemory[0x02C] = 0xF0;
+
+    // The sprite 9
+    cpu->mainMemory[0x02D] = 0xF0;
+    cpu->mainMemory[0x02E] = 0x90;
+    cpu->mainMemory[0x02F] = 0xF0;
+    cpu->mainMemory[0x030] = 0x10;
+    cpu->mainMemory[0x031] = 0xF0;
+
+    // The sprite A
+    cpu->mainMemory[0x032] = 0xF0;
+    cpu->mainMemory[0x033] = 0x90;
+    cpu->mainMemory[0x034] = 0xF0;
+    cpu->mainMemory[0x035] = 0x90;
+    cpu->mainMemory[0x036] = 0x90;
+
+    // The sprite B
+    cpu->mainMemory[0x037] = 0xE0;
+    cpu->mainMemory[0x038] = 0x90;
+    cpu->mainMemory[0x039] = 0xE0;
+    cpu->mainMemory[0x03A] = 0x90;
+    cpu->mainMemory[0x03B] = 0xE0;
+
+    // The sprite C
+    cpu->mainMemory[0x03C] = 0xF0;
+    cpu->mainMemory[0x03D] = 0x80;
+    cpu->mainMemory[0x03E] = 0x80;
+    cpu->mainMemory[0x03F] = 0x80;
+    cpu->mainMemory[0x040] = 0xF0;
+
+    // The sprite D
+    cpu->mainMemory[0x041] = 0xE0;
+    cpu->mainMemory[0x042] = 0x90;
+    cpu->mainMemory[0x043] = 0x90;
+    cpu->mainMemory[0x044] = 0x90;
+    cpu->mainMemory[0x045] = 0xE0;
+
+    // The sprite E
+    cpu->mainMemory[0x046] = 0xF0;
+    cpu->mainMemory[0x047] = 0x80;
+    cpu->mainMemory[0x048] = 0xF0;
+    cpu->mainMemory[0x049] = 0x80;
+    cpu->mainMemory[0x04A] = 0xF0;
+
+    // The sprite F
+    cpu->mainMemory[0x04B] = 0xF0;
+    cpu->mainMemory[0x04C] = 0x80;
+    cpu->mainMemory[0x04D] = 0xF0;
+    cpu->mainMemory[0x04E] = 0x80;
+    cpu->mainMemory[0x04F] = 0x80;
+}
+
+// Write the SUPER-CHIP 8x10 hexadecimal sprites FX30 points at. SUPER-CHIP only
+// had 0-9, the letters follow Octo
+void InitLargeSprites(CHIP8 *cpu)
+{
+    static const BYTE sprites[16 * LARGE_FONT_SIZE] =
+    {
+        0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF,     // 0
+        0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF,     // 1
+        0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF,     // 2
+        0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF,     // 3
+        0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03,     // 4
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF,     // 5
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF,     // 6
+        0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18,     // 7
+        0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF,     // 8
+        0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF,     // 9
+        0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3,     // A
+        0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC,     // B
+        0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C,     // C
+        0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC,     // D
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF,     // E
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0      // F
+    };
+
+    memcpy(&cpu->mainMemory[LARGE_FONT_START], sprites, sizeof(sprites));
+}
+
+// Count down the delay and sound timers. Called once per 60Hz frame
+void StepTimers(CHIP8 *cpu)
+{
+    if(cpu->regDT > 0)
+        --cpu->regDT;
+    if(cpu->regST > 0)
+        --cpu->regST;
+}
+
+void WriteMemory(CHIP8 *cpu, WORD addr, const BYTE *data, unsigned int length)
+{
+    unsigned int i;
+
+    for(i = 0; i < length; ++i)
+    {
+        WORD target = (addr + i) & ADDRESS_MASK;
+
+        // Skip runs of 64 identical bytes at a time when they don't wrap
+        if((i & 63) == 0 && length - i >= 64 && target + 64 <= MEMORY_SIZE &&
+           memcmp(&cpu->mainMemory[target], &data[i], 64) == 0)
+        {
+            i += 63;
+            continue;
+        }
+
+        if(cpu->mainMemory[target] != data[i])
+            StoreByte(cpu, target, data[i]);
+    }
+}
+
+// Same order as QuirkProfile
+static const char *quirkNames[] = { "modern", "vip", "chip48", "schip", "xochip" };
+
+int FindQuirkProfile(const char *name)
+{
+    int i;
+
+    for(i = 0; i < (int)(sizeof(quirkNames) / sizeof(quirkNames[0])); ++i)
+    {
+        if(strcmp(name, quirkNames[i]) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+const char *QuirkProfileName(QuirkProfile quirks)
+{
+    return quirkNames[quirks];
+}
+
+// Switch interpreters. Any decode state from the previous engine is dropped
+int SetEngine(CHIP8 *cpu, Engine engine)
+{
+    ReleaseEngine(cpu);
+
+    if(engine == ENGINE_CACHED)
+    {
+        cpu->decodeCache = CreateDecodeCache();
+        if(cpu->decodeCache == NULL)
+            return -1;
+    }
+    else if(engine == ENGINE_JIT)
+    {
+        cpu->jitCache = CreateJITCache();
+        if(cpu->jitCache == NULL)
+            return -1;
+    }
+    else if(engine == ENGINE_AOT)
+    {
+        cpu->aotCache = CreateAOTCache(cpu->aotProgram);
+        if(cpu->aotCache == NULL)
+            return -1;
+    }
+
+    cpu->engine = engine;
+    return 0;
+}
+
+// Free whatever the current engine allocated and fall back to the switch interpreter
+void ReleaseEngine(CHIP8 *cpu)
+{
+    if(cpu->decodeCache != NULL)
+        DestroyDecodeCache(cpu->decodeCache);
+    cpu->decodeCache = NULL;
+    if(cpu->jitCache != NULL)
+        DestroyJITCache(cpu->jitCache);
+    cpu->jitCache = NULL;
+    if(cpu->aotCache != NULL)
+        DestroyAOTCache(cpu->aotCache);
+    cpu->aotCache = NULL;
+    cpu->engine = ENGINE_SWITCH;
+}
+
+// Fetch and execute count instructions back to back
+void RunCycles(CHIP8 *cpu, unsigned long count)
+{
+    // Timers and keys may have changed since the last call, so loops seen then
+    // prove nothing now
+    cpu->idle.target = 0xFFFF;
+
+    switch(cpu->engine)
+    {
+        case ENGINE_CACHED:
+            RunCyclesCached(cpu, count);
+            break;
+        case ENGINE_JIT:
+            RunCyclesJIT(cpu, count);
+            break;
+        case ENGINE_AOT:
+            RunCyclesAOT(cpu, count);
+            break;
+        default:
+            QUIRK_SELECT(cpu, RunCyclesSwitch, (cpu, count));
+            break;
+    }
+}
+
+// Engines call this whenever control moves backwards (a jump to an earlier
+// address, or FX0A waiting on a key) with remaining cycles left in the current
+// RunCycles call. If the machine is exactly as it was the last time control
+// jumped back to this address, and nothing was written in between, then every
+// further trip round the loop is identical until a timer tick or key change,
+// which only happen between RunCycles calls. Returns the whole number of loop
+// iterations' worth of cycles that can be skipped without changing the outcome
+unsigned long IdleSkip(CHIP8 *cpu, unsigned long remaining)
+{
+    IdleProbe *idle = &cpu->idle;
+
+    if(!cpu->idleSkip)
+        return 0;
+
+    if(idle->target == cpu->PC &&
+       idle->writeCount == cpu->writeCount &&
+       idle->regI == cpu->regI &&
+       idle->SP == cpu->SP &&
+       idle->regDT == cpu->regDT &&
+       idle->regST == cpu->regST &&
+       idle->rngState == cpu->rngState &&
+       memcmp(idle->dataRegisters, cpu->dataRegisters, NUM_REGISTERS) == 0)
+    {
+        unsigned long length = idle->remaining - remaining;
+        unsigned long skip = remaining - remaining % length;
+
+        cpu->idleCycles += skip;
+        return skip;
+    }
+
+    // Remember this visit to compare against the next one
+    idle->target = cpu->PC;
+    idle->remaining = remaining;
+    idle->writeCount = cpu->writeCount;
+    idle->regI = cpu->regI;
+    idle->SP = cpu->SP;
+    idle->regDT = cpu->regDT;
+    idle->regST = cpu->regST;
+    idle->rngState = cpu->rngState;
+    memcpy(idle->dataRegisters, cpu->dataRegisters, NUM_REGISTERS);
+
+    return 0;
+}
+
+// Execute one 60Hz frame worth of instructions, then tick the timers. Timing is
+// derived purely from instruction count, so runs are deterministic
+void RunFrame(CHIP8 *cpu, unsigned int cyclesPerFrame)
+{
+    RunCycles(cpu, cyclesPerFrame);
+    StepTimers(cpu);
+}
+
+// Fetch the next instruction for execution
+WORD Fetch(CHIP8 *cpu)
+{
+    // Bitwise logic is necessary because memory is indexed by BYTE and an instruction
+    // is a WORD (two BYTES). PC always stays inside memory, wrapping at the top
+    WORD inst = cpu->mainMemory[cpu->PC & ADDRESS_MASK];
+    inst <<= 8;
+    inst |= cpu->mainMemory[(cpu->PC + 1) & ADDRESS_MASK];
+    cpu->PC = (cpu->PC + 2) & ADDRESS_MASK;
+
+    return inst;
+}
+
+// Calls the correct execute function for a given instruction or the correct decode
+// function for a set of possible instructions, following cpu's quirk profile
+void DecodeExecute(CHIP8 *cpu, WORD inst)
+{
+    QUIRK_SELECT(cpu, DecodeExecute, (cpu, inst));
+}
+
+DecodeFunction SelectDecodeExecute(QuirkProfile quirks)
+{
+    // Same order as QuirkProfile
+    static const DecodeFunction decoders[QUIRK_PROFILES] =
+    {
+        DecodeExecute_MODERN, DecodeExecute_VIP, DecodeExecute_CHIP48, DecodeExecute_SCHIP, DecodeExecute_XOCHIP
+    };
+
+    return decoders[quirks];
+}
+
+// Calls the correct execution function for a given instruction that begins with 0
+void Decode0000(CHIP8 *cpu, WORD inst)
+{
+    switch(inst)
+    {
+        case 0x00E0: Execute00E0(cpu); break;
+        case 0x00EE: Execute00EE(cpu); break;
+        case 0x00FB: Execute00FB(cpu); break;
+        case 0x00FC: Execute00FC(cpu); break;
+        case 0x00FD: Execute00FD(cpu); break;
+        case 0x00FE: Execute00FE(cpu); break;
+        case 0x00FF: Execute00FF(cpu); break;
+        default:
+            if((inst & 0xFFF0) == 0x00C0)
+                Execute00CN(cpu, inst);
+            else
+                Execute0NNN(cpu, inst);
+            break;
+    }
+}
+
+// Calls the correct execution function for a given instruction that begins with 8
+void Decode8000(CHIP8 *cpu, WORD inst)
+{
+    switch(inst & 0x000F)
+    {
+        case 0x0000: Execute8XY0(cpu, inst); break;
+        case 0x0001: Execute8XY1(cpu, inst); break;
+        case 0x0002: Execute8XY2(cpu, inst); break;
+        case 0x0003: Execute8XY3(cpu, inst); break;
+        case 0x0004: Execute8XY4(cpu, inst); break;
+        case 0x0005: Execute8XY5(cpu, inst); break;
+        case 0x0006: Execute8XY6(cpu, inst); break;
+        case 0x0007: Execute8XY7(cpu, inst); break;
+        case 0x000E: Execute8XYE(cpu, inst); break;
+        default: break;
+    }
+}
+
+// Calls the correct execution function for a given instruction that begins with E
+void DecodeE000(CHIP8 *cpu, WORD inst)
+{
+    switch(inst & 0xF0FF)
+    {
+        case 0xE09E: ExecuteEX9E(cpu, inst); break;
+        case 0xE0A1: ExecuteEXA1(cpu, inst); break;
+        default: break;
+    }
+}
+
+// Calls the correct execution function for a given instruction that begins with F
+void DecodeF000(CHIP8 *cpu, WORD inst)
+{
+    switch(inst & 0x00FF)
+    {
+        case 0x0007: ExecuteFX07(cpu, inst); break;
+        case 0x000A: ExecuteFX0A(cpu, inst); break;
+        case 0x0015: ExecuteFX15(cpu, inst); break;
+        case 0x0018: ExecuteFX18(cpu, inst); break;
+        case 0x001E: ExecuteFX1E(cpu, inst); break;
+        case 0x0029: ExecuteFX29(cpu, inst); break;
+        case 0x0030: ExecuteFX30(cpu, inst); break;
+        case 0x0033: ExecuteFX33(cpu, inst); break;
+        case 0x0055: ExecuteFX55(cpu, inst); break;
+        case 0x0065: ExecuteFX65(cpu, inst); break;
+        case 0x0075: ExecuteFX75(cpu, inst); break;
+        case 0x0085: ExecuteFX85(cpu, inst); break;
+        default: break;
+    }
+}
+
+// 00E0 - CLS : Clear the screen
+void Execute00E0(CHIP8 *cpu)
+{
+    uint64_t lit = 0;
+    int y;
+
+    // Only flag a redraw if a lit pixel is actually cleared. The low resolution
+    // words come first, so that case is a loop of constant length
+    for(y = 0; y < SCREEN_HEIGHT; ++y)
+    {
+        lit |= cpu->screenRows[y];
+        cpu->screenRows[y] = 0;
+    }
+    for(y = SCREEN_HEIGHT; cpu->hires && y < 2 * HIRES_HEIGHT; ++y)
+    {
+        lit |= cpu->screenRows[y];
+        cpu->screenRows[y] = 0;
+    }
+    cpu->screenDirty |= lit != 0;
+    ++cpu->writeCount;
+}
+
+// 00EE - RET : Return from subroutine
+void Execute00EE(CHIP8 *cpu)
+{
+    // Memory is indexed by BYTE so fetch both BYTES of the WORD in memory at SP.
+    // An unbalanced return wraps SP round memory rather than leaving it
+    cpu->SP = (cpu->SP - 2) & ADDRESS_MASK;
+    WORD lo = cpu->mainMemory[(cpu->SP + 1) & ADDRESS_MASK];
+    WORD hi = cpu->mainMemory[cpu->SP] << 8;
+    cpu->PC = (lo | hi) & ADDRESS_MASK;
+}
+
+// 00CN - SCD N : Scroll the screen down N rows
+void Execute00CN(CHIP8 *cpu, WORD inst)
+{
+    unsigned int n = inst & 0x000F;
+    unsigned int rows = cpu->hires ? HIRES_HEIGHT : SCREEN_HEIGHT;
+    unsigned int half;
+
+    // Each half of the screen is a run of whole rows, so this is one memmove per half
+    for(half = 0; half < SCREEN_WORDS(cpu); half += HIRES_HEIGHT)
+    {
+        uint64_t *column = &cpu->screenRows[half];
+        memmove(column + n, column, (rows - n) * sizeof(column[0]));
+        memset(column, 0, n * sizeof(column[0]));
+    }
+
+    cpu->screenDirty = 1;
+    ++cpu->writeCount;
+}
+
+// 00FB - SCR : Scroll the screen right 4 columns
+void Execute00FB(CHIP8 *cpu)
+{
+    int y;
+
+    if(cpu->hires)
+    {
+        // Carry the low bits of the left half into the right one
+        for(y = 0; y < HIRES_HEIGHT; ++y)
+        {
+            uint64_t *left = &cpu->screenRows[y];
+            uint64_t *right = &cpu->screenRows[HIRES_HEIGHT + y];
+
+            *right = *right >> SCROLL_STEP | *left << (64 - SCROLL_STEP);
+            *left >>= SCROLL_STEP;
+        }
+    }
+    else
+    {
+        for(y = 0; y < SCREEN_HEIGHT; ++y)
+            cpu->screenRows[y] >>= SCROLL_STEP;
+    }
+
+    cpu->screenDirty = 1;
+    ++cpu->writeCount;
+}
+
+// 00FC - SCL : Scroll the screen left 4 columns
+void Execute00FC(CHIP8 *cpu)
+{
+    int y;
+
+    if(cpu->hires)
+    {
+        // Carry the high bits of the right half into the left one
+        for(y = 0; y < HIRES_HEIGHT; ++y)
+        {
+            uint64_t *left = &cpu->screenRows[y];
+            uint64_t *right = &cpu->screenRows[HIRES_HEIGHT + y];
+
+            *left = *left << SCROLL_STEP | *right >> (64 - SCROLL_STEP);
+            *right <<= SCROLL_STEP;
+        }
+    }
+    else
+    {
+        for(y = 0; y < SCREEN_HEIGHT; ++y)
+            cpu->screenRows[y] <<= SCROLL_STEP;
+    }
+
+    cpu->screenDirty = 1;
+    ++cpu->writeCount;
+}
+
+// 00FD - EXIT : Stop the program
+void Execute00FD(CHIP8 *cpu)
+{
+    // There is nothing to exit to, so spin here like a blocked FX0A
+    cpu->PC = (cpu->PC - 2) & ADDRESS_MASK;
+}
+
+// Change resolution and clear the screen, keeping the unused words zero
+static void SetResolution(CHIP8 *cpu, BYTE hires)
+{
+    memset(cpu->screenRows, 0, sizeof(cpu->screenRows));
+    cpu->hires = hires;
+    cpu->screenDirty = 1;
+    ++cpu->writeCount;
+}
+
+// 00FE - LOW : Switch to 64x32 resolution
+void Execute00FE(CHIP8 *cpu)
+{
+    SetResolution(cpu, 0);
+}
+
+// 00FF - HIGH : Switch to 128x64 resolution
+void Execute00FF(CHIP8 *cpu)
+{
+    SetResolution(cpu, 1);
+}
+
+// 0NNN - SYS addr : Jump to machine code routine at NNN
+void Execute0NNN(CHIP8 *cpu, WORD inst)
+{
+    // This is only necessary in actual hardware
+}
+
+// 1NNN - JP addr : Jump to location NNN
+void Execute1NNN(CHIP8 *cpu, WORD inst)
+{
+    cpu->PC = inst & 0x0FFF;
+}
+
+// 2NNN - CALL addr : Call subroutine at NNN
+void Execute2NNN(CHIP8 *cpu, WORD inst)
+{
+    // Memory is indexed by BYTE so store both BYTES of the WORD in memory at SP.
+    // Runaway recursion wraps SP round memory, overwriting whatever is there
+    StoreByte(cpu, cpu->SP, (cpu->PC & 0xFF00) >> 8);
+    StoreByte(cpu, cpu->SP + 1, cpu->PC & 0x00FF);
+    cpu->SP = (cpu->SP + 2) & ADDRESS_MASK;
+    cpu->PC = inst & 0x0FFF;
+}
+
+// 3XNN - SE Vx, NN : Skip next instruction if Vx == NN
+void Execute3XNN(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    int n = inst & 0x00FF;
+
+    if(cpu->dataRegisters[x] == n)
+        cpu->PC = (cpu->PC + 2) & ADDRESS_MASK;
+}
+
+// 4XNN - SNE Vx, NN : Skip next instruction if Vx != NN
+void Execute4XNN(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    int n = inst & 0x00FF;
+
+    if(cpu->dataRegisters[x] != n)
+        cpu->PC = (cpu->PC + 2) & ADDRESS_MASK;
+}
+
+// 5XY0 - SE Vx, Vy : Skip next instruction if Vx == Vy
+void Execute5XY0(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    unsigned int y = (inst & 0x00F0) >> 4;
+
+    if(cpu->dataRegisters[x] == cpu->dataRegisters[y])
+        cpu->PC = (cpu->PC + 2) & ADDRESS_MASK;
+}
+
+// 6XNN - LD Vx, NN : Load NN into Vx (Vx == NN)
+void Execute6XNN(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    cpu->dataRegisters[x] = inst & 0x00FF;
+}
+
+// 7XNN - ADD Vx, NN : Add NN to Vx and store result into Vx
+void Execute7XNN(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    int n = inst & 0x00FF;
+
+    cpu->dataRegisters[x] += n;
+}
+
+// 8XY0 - LD Vx, Vy : Load Vy into Vx (Vx == Vy)
+void Execute8XY0(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    unsigned int y = (inst & 0x00F0) >> 4;
+
+    cpu->dataRegisters[x] = cpu->dataRegisters[y];
+}
+
+// 8XY1 - OR Vx, Vy : Bitwise or Vx and Vy and store result into Vx
+void Execute8XY1(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    unsigned int y = (inst & 0x00F0) >> 4;
+
+    cpu->dataRegisters[x] |= cpu->dataRegisters[y];
+}
+
+// 8XY2 - AND Vx, Vy : Bitwise and Vx and Vy and store result into Vx
+void Execute8XY2(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    unsigned int y = (inst & 0x00F0) >> 4;
+
+    cpu->dataRegisters[x] &= cpu->dataRegisters[y];
+}
+
+// 8XY3 - XOR Vx, Vy : Bitwise xor Vx and Vy and store result into Vx
+void Execute8XY3(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    unsigned int y = (inst & 0x00F0) >> 4;
+
+    cpu->dataRegisters[x] ^= cpu->dataRegisters[y];
+}
+
+// 8XY4 - ADD Vx, Vy : Add Vx and Vy and store result into Vx
+void Execute8XY4(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    unsigned int y = (inst & 0x00F0) >> 4;
+
+    // Check for carry and set VF appropriately
+    WORD check = cpu->dataRegisters[x] + cpu->dataRegisters[y];
+    if(check > 0xFF)
+        cpu->dataRegisters[0xF] = 1;
+    else
+        cpu->dataRegisters[0xF] = 0;
+
+    cpu->dataRegisters[x] += cpu->dataRegisters[y];
+}
+
+// 8XY5 - SUB Vx, Vy : Subtract Vy from Vx and store result into Vx
+void Execute8XY5(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    unsigned int y = (inst & 0x00F0) >> 4;
+
+    // Check for borrow and set VF appropriately
+    if(cpu->dataRegisters[x] > cpu->dataRegisters[y])
+        cpu->dataRegisters[0xF] = 1;
+    else
+        cpu->dataRegisters[0xF] = 0;
+
+    cpu->dataRegisters[x] = cpu->dataRegisters[x] - cpu->dataRegisters[y];
+}
+
+// 8XY6 - SHR Vx {, Vy} : Set Vx to Vx >> 1. The shifted register depends on the profile
+void Execute8XY6(CHIP8 *cpu, WORD inst)
+{
+    QUIRK_SELECT(cpu, Execute8XY6, (cpu, inst));
+}
+
+// 8XY7 - SUBN Vx, Vy : Subtract Vx from Vy and store result into Vx
+void Execute8XY7(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    unsigned int y = (inst & 0x00F0) >> 4;
+
+    // Check for borrow and set VF appropriately
+    if(cpu->dataRegisters[y] > cpu->dataRegisters[x])
+        cpu->dataRegisters[0xF] = 1;
+    else
+        cpu->dataRegisters[0xF] = 0;
+
+    cpu->dataRegisters[x] = cpu->dataRegisters[y] - cpu->dataRegisters[x];
+}
+
+// 8XYE - SHL Vx {, Vy} : Set Vx to Vx << 1. The shifted register depends on the profile
+void Execute8XYE(CHIP8 *cpu, WORD inst)
+{
+    QUIRK_SELECT(cpu, Execute8XYE, (cpu, inst));
+}
+
+// 9XY0 - SNE Vx, Vy : Skip next instruction if Vx != Vy
+void Execute9XY0(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    unsigned int y = (inst & 0x00F0) >> 4;
+
+    if(cpu->dataRegisters[x] != cpu->dataRegisters[y])
+        cpu->PC = (cpu->PC + 2) & ADDRESS_MASK;
+}
+
+// ANNN - LD I, addr : Set regI to NNN
+void ExecuteANNN(CHIP8 *cpu, WORD inst)
+{
+    cpu->regI = inst & 0x0FFF;
+}
+
+// BNNN - JP V0, addr : Jump to address NNN + V0. The offset register depends on the profile
+void ExecuteBNNN(CHIP8 *cpu, WORD inst)
+{
+    QUIRK_SELECT(cpu, ExecuteBNNN, (cpu, inst));
+}
+
+// CXNN - RND Vx, NN : Set Vx to random BYTE & NN
+void ExecuteCXNN(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    int n = inst & 0x00FF;
+    uint64_t state = cpu->rngState;
+
+    // One xorshift64* step. The top byte of the product is the best mixed
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    cpu->rngState = state;
+
+    cpu->dataRegisters[x] = (state * 0x2545F4914F6CDD1DULL >> 56) & n;
+}
+
+// DXYN - DRW Vx, Vy, N : Draw N BYTE sprite from memory at regI to screen data starting
+// at position Vx, Vy. Edges clip or wrap depending on the profile
+void ExecuteDXYN(CHIP8 *cpu, WORD inst)
+{
+    QUIRK_SELECT(cpu, ExecuteDXYN, (cpu, inst));
+}
+
+// EX9E - SKP Vx : Skip next instruction if key Vx is pressed
+void ExecuteEX9E(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    unsigned int keyIndex = cpu->dataRegisters[x] & (NUM_KEYS - 1);
+
+    if(cpu->inputKeys[keyIndex] == 0xFF)
+        cpu->PC = (cpu->PC + 2) & ADDRESS_MASK;
+}
+
+// EXA1 = SKNP Vx : Skip next instruction if key VX is NOT pressed
+void ExecuteEXA1(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    unsigned int keyIndex = cpu->dataRegisters[x] & (NUM_KEYS - 1);
+
+    if(cpu->inputKeys[keyIndex] == 0x00)
+        cpu->PC = (cpu->PC + 2) & ADDRESS_MASK;
+}
+
+// FX07 - LD Vx, DT : Set Vx to the value of the delay timer
+void ExecuteFX07(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    cpu->dataRegisters[x] = cpu->regDT;
+}
+
+// FX0A - LD Vx, K : Load Vx with the key that was pressed
+void ExecuteFX0A(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    int i;
+
+    int key = -1;
+    for(i = 0; i < NUM_KEYS; ++i)
+    {
+        if(cpu->inputKeys[i] == 0xFF)
+            key = i;
+    }
+
+    // This is a blocking operation. Repeat until a key is pressed
+    if(key == -1)
+        cpu->PC = (cpu->PC - 2) & ADDRESS_MASK;
+    else
+        cpu->dataRegisters[x] = key;
+}
+
+// FX15 - LD DT, Vx : Set the delay timer to the value of Vx
+void ExecuteFX15(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    cpu->regDT = cpu->dataRegisters[x];
+}
+
+// FX18 - LD ST, Vx : Set the sound timer to the value of Vx
+void ExecuteFX18(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    cpu->regST = cpu->dataRegisters[x];
+}
+
+// FX1E - ADD I, Vx : Set regI to itself plus the value of Vx
+void ExecuteFX1E(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    cpu->regI = cpu->regI + cpu->dataRegisters[x];
+}
+
+// FX29 - LD F, Vx : Set regI to the location for the hex sprite in Vx
+void ExecuteFX29(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    cpu->regI = cpu->mainMemory[cpu->dataRegisters[x] * 5];
+}
+
+// FX30 - LD HF, Vx : Set regI to the location for the large hex sprite in Vx
+void ExecuteFX30(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    cpu->regI = LARGE_FONT_START + (cpu->dataRegisters[x] & 0x0F) * LARGE_FONT_SIZE;
+}
+
+// FX33 - LD B, Vx : Store a decimal representation of Vx in memory at regI to regI + 2
+void ExecuteFX33(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+
+    int hundreds = cpu->dataRegisters[x] / 100;
+    int tens = (cpu->dataRegisters[x] % 100) / 10;
+    int ones = cpu->dataRegisters[x] % 10;
+
+    StoreByte(cpu, cpu->regI, hundreds);
+    StoreByte(cpu, cpu->regI + 1, tens);
+    StoreByte(cpu, cpu->regI + 2, ones);
+}
+
+// FX55 - LD [I], Vx : Store registers V0 through Vx into memory at regI. Whether regI
+// moves past them depends on the profile
+void ExecuteFX55(CHIP8 *cpu, WORD inst)
+{
+    QUIRK_SELECT(cpu, ExecuteFX55, (cpu, inst));
+}
+
+// FX65 - LD Vx, [I] : Load registers V0 through Vx from memory at regI. Whether regI
+// moves past them depends on the profile
+void ExecuteFX65(CHIP8 *cpu, WORD inst)
+{
+    QUIRK_SELECT(cpu, ExecuteFX65, (cpu, inst));
+}
+
+// FX75 - LD R, Vx : Save registers V0 through Vx in the user flags
+void ExecuteFX75(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    memcpy(cpu->userFlags, cpu->dataRegisters, x + 1);
+    ++cpu->writeCount;
+}
+
+// FX85 - LD Vx, R : Load registers V0 through Vx from the user flags
+void ExecuteFX85(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    memcpy(cpu->dataRegisters, cpu->userFlags, x + 1);
+}
+
+// DXYN at high resolution, and DXY0, which draws a 16x16 sprite of two BYTE rows,
+// at either. The plain low resolution case stays in ExecuteDXYN. A high resolution
+// row spans two words, so the sprite is shifted across both as one 128 bit value
+static void DrawExtended(CHIP8 *cpu, WORD inst, int wrap)
+{
+    unsigned int regX = (inst & 0x0F00) >> 8;
+    unsigned int regY = (inst & 0x00F0) >> 4;
+    unsigned int rows = cpu->hires ? HIRES_HEIGHT : SCREEN_HEIGHT;
+    unsigned int startX = cpu->dataRegisters[regX] % (cpu->hires ? HIRES_WIDTH : SCREEN_WIDTH);
+    unsigned int startY = cpu->dataRegisters[regY] % rows;
+    unsigned int height = inst & 0x000F;
+    unsigned int bytes = 1; // Per sprite row
+
+    uint64_t collision = 0;
+    uint64_t flipped = 0;
+    unsigned int line;
+
+    if(height == 0)
+    {
+        height = LARGE_SPRITE_WIDTH;
+        bytes = 2;
+    }
+    if(!wrap && height > rows - startY)
+        height = rows - startY;
+
+    for(line = 0; line < height; ++line)
+    {
+        WORD addr = cpu->regI + line * bytes;
+        uint64_t sprite = cpu->mainMemory[addr & ADDRESS_MASK];
+        unsigned int row = (startY + line) % rows;
+        uint64_t left;
+        uint64_t right = 0;    // Pixels past column 63
+
+        if(bytes == 2)
+            sprite = sprite << 8 | cpu->mainMemory[(addr + 1) & ADDRESS_MASK];
+        sprite <<= 64 - 8 * bytes;
+
+        if(startX < 64)
+        {
+            left = sprite >> startX;
+            if(startX != 0)
+                right = sprite << (64 - startX);
+        }
+        else
+        {
+            // Only reachable at high resolution. Wrapping brings pixels past
+            // column 127 back round to column 0
+            left = wrap && startX != 64 ? sprite << (128 - startX) : 0;
+            right = sprite >> (startX - 64);
+        }
+
+        // At low resolution anything past column 63 is off the screen
+        if(!cpu->hires)
+        {
+            if(wrap)
+                left |= right;
+            right = 0;
+        }
+
+        collision |= cpu->screenRows[row] & left;
+        cpu->screenRows[row] ^= left;
+        collision |= cpu->screenRows[HIRES_HEIGHT + row] & right;
+        cpu->screenRows[HIRES_HEIGHT + row] ^= right;
+        flipped |= left | right;
+    }
+
+    cpu->dataRegisters[0xF] = collision != 0;
+    cpu->screenDirty |= flipped != 0;
+    ++cpu->writeCount;
+}
+
+// One specialized copy of the quirk-dependent code per profile
+#define QUIRK_PROFILE MODERN
+#include "quirkexec.h"
+#undef QUIRK_PROFILE
+
+#define QUIRK_PROFILE VIP
+#include "quirkexec.h"
+#undef QUIRK_PROFILE
+
+#define QUIRK_PROFILE CHIP48
+#include "quirkexec.h"
+#undef QUIRK_PROFILE
+
+#define QUIRK_PROFILE SCHIP
+#include "quirkexec.h"
+#undef QUIRK_PROFILE
+
+#define QUIRK_PROFILE XOCHIP
+#include "quirkexec.h"
+#undef QUIRK_PROFILE
@@ -0,0 +1,229 @@
+#ifndef CHIP8CORE_H
+#define CHIP8CORE_H
+
+#include <stdint.h>
+
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+
+// CPU constants
+#define MEMORY_SIZE 0x1000
+#define ADDRESS_MASK 0xFFF
+#define STACK_START 0xEA0
+#define PROGRAM_START 0x200
+#define MAX_ROM_SIZE (MEMORY_SIZE - PROGRAM_START)  // Largest program that fits above the reserved area
+#define MEMORY_PAGE_SIZE 0x100   // Granularity stores are tracked at, see dirtyPages
+#define MEMORY_PAGES (MEMORY_SIZE / MEMORY_PAGE_SIZE)
+#define NUM_REGISTERS 16
+#define NUM_KEYS 16
+
+// Graphics constants
+#define SCREEN_WIDTH 64
+#define SCREEN_HEIGHT 32
+#define SPRITE_WIDTH 8
+#define HIRES_WIDTH 128     // SUPER-CHIP high resolution, see CHIP8.hires
+#define HIRES_HEIGHT 64
+#define LARGE_SPRITE_WIDTH 16   // DXY0 sprites are 16x16
+#define SCROLL_STEP 4       // Columns 00FB and 00FC scroll by
+
+// Fonts. The small hex digits are 5 bytes each from address 0, the SUPER-CHIP
+// large ones 10 bytes each straight after
+#define SMALL_FONT_SIZE 5
+#define LARGE_FONT_START 0x050
+#define LARGE_FONT_SIZE 10
+
+// SUPER-CHIP RPL user flags saved and restored by FX75 and FX85
+#define NUM_USER_FLAGS 16
+
+// Words of screenRows in use at the machine's current resolution
+#define SCREEN_WORDS(cpu) ((cpu)->hires ? 2 * HIRES_HEIGHT : SCREEN_HEIGHT)
+
+// Timing constants
+#define TIMER_HZ 60
+#define CYCLES_PER_FRAME 10 // Instructions executed per 60Hz timer tick
+
+// Interpreters RunCycles can execute with
+typedef enum Engine
+{
+    ENGINE_SWITCH,  // Fetch and decode every instruction through DecodeExecute
+    ENGINE_CACHED,  // Decode each address once and reuse the record, see cache.h
+    ENGINE_JIT,     // Translate basic blocks to x86-64, see jit.h
+    ENGINE_AOT      // Run blocks translated to C by chip8-translate, see aot.h
+} Engine;
+
+// Implementations whose differing semantics a machine can follow, see quirks.h
+typedef enum QuirkProfile
+{
+    QUIRKS_MODERN,  // Shifts in place, I unchanged by FX55/FX65, BNNN uses V0, sprites clip
+    QUIRKS_VIP,     // COSMAC VIP: shifts read Vy, FX55/FX65 advance I past the registers
+    QUIRKS_CHIP48,  // HP48 CHIP-48: FX55/FX65 advance I by X, BXNN uses VX
+    QUIRKS_SCHIP,   // SUPER-CHIP 1.1: BXNN uses VX
+    QUIRKS_XOCHIP   // XO-CHIP: as the VIP, but sprites wrap round the screen edges
+} QuirkProfile;
+
+#define QUIRK_PROFILES (QUIRKS_XOCHIP + 1)
+
+// Machine state seen at the head of the most recent backward jump, see IdleSkip
+typedef struct IdleProbe
+{
+    WORD target;                // Address control jumped back to
+    unsigned long remaining;    // Cycles left in the RunCycles call at the time
+    unsigned long writeCount;   // CHIP8.writeCount at the time
+    BYTE dataRegisters[NUM_REGISTERS];
+    WORD regI;
+    WORD SP;
+    BYTE regDT;
+    BYTE regST;
+    uint64_t rngState;          // A loop drawing random numbers is never idle
+} IdleProbe;
+
+// Complete state of a single chip8 machine. Nothing in the core touches global
+// state, so any number of machines can live side by side in one process
+typedef struct CHIP8
+{
+    // Program should reside in 0x200 - 0xE9F inclusive
+    BYTE mainMemory[MEMORY_SIZE];
+
+    // Main general purpose registers with the exception of 0xF
+    // 0xF is used for flags
+    BYTE dataRegisters[NUM_REGISTERS];
+
+    // Represents the current status of input keys
+    // 0xFF is pressed, 0x00 is unpressed
+    BYTE inputKeys[NUM_KEYS];
+
+    BYTE regDT; // Delay Timer
+    BYTE regST; // Sound Timer
+    WORD regI;  // Address register
+    WORD PC;    // Program counter, always inside memory
+    WORD SP;    // Stack pointer, always inside memory
+
+    // One bit per pixel, one word per row. The most significant bit of a row is
+    // column 0 and a set bit is a lit pixel. At low resolution only the first
+    // SCREEN_HEIGHT words are used. At high resolution word y holds columns 0-63
+    // of row y and word HIRES_HEIGHT + y columns 64-127. Changing resolution
+    // clears the screen, so words the current one doesn't use are always zero
+    uint64_t screenRows[2 * HIRES_HEIGHT];
+    BYTE hires;
+
+    // Set whenever screenRows changes, cleared by whoever presents or saves it
+    BYTE screenDirty;
+
+    // One bit per memory page stored to since the owner last cleared it, see fork.h
+    WORD dirtyPages;
+
+    // xorshift64* state behind CXNN. Never zero, see SeedRandom
+    uint64_t rngState;
+
+    // Survives FX75/FX85 round trips the way the HP48's RPL flags did
+    BYTE userFlags[NUM_USER_FLAGS];
+
+    // Semantics of the opcodes implementations disagree on. Chosen per ROM by
+    // the caller, and left alone by InitializeCPU
+    QuirkProfile quirks;
+
+    // Interpreter selected by SetEngine and any decode state it keeps. These are
+    // host-side bookkeeping, not part of the emulated machine. ENGINE_AOT runs
+    // aotProgram, which the caller sets before choosing it
+    Engine engine;
+    struct DecodeCache *decodeCache;
+    struct JITCache *jitCache;
+    const struct AOTProgram *aotProgram;
+    struct AOTCache *aotCache;
+
+    // Busy-wait loops are fast-forwarded when idleSkip is set. writeCount is bumped
+    // by anything that changes memory, the screen or the user flags, and
+    // idleCycles counts the instructions that were skipped
+    BYTE idleSkip;
+    unsigned long writeCount;
+    unsigned long idleCycles;
+    IdleProbe idle;
+
+    // Counters filled in while set, see profile.h. Only builds with CHIP8_PROFILE
+    // defined ever look at it
+    struct Profile *profile;
+} CHIP8;
+
+// Helper functions for CPU
+void InitializeCPU(CHIP8 *cpu);
+void InitNumericalSprites(CHIP8 *cpu);
+void InitLargeSprites(CHIP8 *cpu);
+void StepTimers(CHIP8 *cpu);
+
+// Restart the machine's random sequence. Equal seeds give equal sequences
+void SeedRandom(CHIP8 *cpu, uint64_t seed);
+
+// Copy length bytes into memory at addr, keeping decoded and translated
+// instructions coherent. Bytes that already hold the new value are not touched
+void WriteMemory(CHIP8 *cpu, WORD addr, const BYTE *data, unsigned int length);
+
+// Profile named name ("modern", "vip", "chip48", "schip" or "xochip"), or -1
+int FindQuirkProfile(const char *name);
+const char *QuirkProfileName(QuirkProfile quirks);
+
+// Choose the interpreter used by RunCycles. Returns non-zero if it could not be set up
+int SetEngine(CHIP8 *cpu, Engine engine);
+void ReleaseEngine(CHIP8 *cpu);
+
+// Run the machine for a number of instructions or whole 60Hz frames
+void RunCycles(CHIP8 *cpu, unsigned long count);
+unsigned long IdleSkip(CHIP8 *cpu, unsigned long remaining);
+void RunFrame(CHIP8 *cpu, unsigned int cyclesPerFrame);
+
+// Implement CPU execution. All the work is done here
+WORD Fetch(CHIP8 *cpu);
+void DecodeExecute(CHIP8 *cpu, WORD inst);
+
+// These ensure the correct execute function is called for a given instruction
+void Decode0000(CHIP8 *cpu, WORD inst);
+void Decode8000(CHIP8 *cpu, WORD inst);
+void DecodeE000(CHIP8 *cpu, WORD inst);
+void DecodeF000(CHIP8 *cpu, WORD inst);
+
+// Emulate the execution for the given instruction
+void Execute00E0(CHIP8 *cpu);
+void Execute00EE(CHIP8 *cpu);
+void Execute00CN(CHIP8 *cpu, WORD inst);
+void Execute00FB(CHIP8 *cpu);
+void Execute00FC(CHIP8 *cpu);
+void Execute00FD(CHIP8 *cpu);
+void Execute00FE(CHIP8 *cpu);
+void Execute00FF(CHIP8 *cpu);
+void Execute0NNN(CHIP8 *cpu, WORD inst);
+void Execute1NNN(CHIP8 *cpu, WORD inst);
+void Execute2NNN(CHIP8 *cpu, WORD inst);
+void Execute3XNN(CHIP8 *cpu, WORD inst);
+void Execute4XNN(CHIP8 *cpu, WORD inst);
+void Execute5XY0(CHIP8 *cpu, WORD inst);
+void Execute6XNN(CHIP8 *cpu, WORD inst);
+void Execute7XNN(CHIP8 *cpu, WORD inst);
+void Execute8XY0(CHIP8 *cpu, WORD inst);
+void Execute8XY1(CHIP8 *cpu, WORD inst);
+void Execute8XY2(CHIP8 *cpu, WORD inst);
+void Execute8XY3(CHIP8 *cpu, WORD inst);
+void Execute8XY4(CHIP8 *cpu, WORD inst);
+void Execute8XY5(CHIP8 *cpu, WORD inst);
+void Execute8XY6(CHIP8 *cpu, WORD inst);
+void Execute8XY7(CHIP8 *cpu, WORD inst);
+void Execute8XYE(CHIP8 *cpu, WORD inst);
+void Execute9XY0(CHIP8 *cpu, WORD inst);
+void ExecuteANNN(CHIP8 *cpu, WORD inst);
+void ExecuteBNNN(CHIP8 *cpu, WORD inst);
+void ExecuteCXNN(CHIP8 *cpu, WORD inst);
+void ExecuteDXYN(CHIP8 *cpu, WORD inst);
+void ExecuteEX9E(CHIP8 *cpu, WORD inst);
+void ExecuteEXA1(CHIP8 *cpu, WORD inst);
+void ExecuteFX07(CHIP8 *cpu, WORD inst);
+void ExecuteFX0A(CHIP8 *cpu, WORD inst);
+void ExecuteFX15(CHIP8 *cpu, WORD inst);
+void ExecuteFX18(CHIP8 *cpu, WORD inst);
+void ExecuteFX1E(CHIP8 *cpu, WORD inst);
+void ExecuteFX29(CHIP8 *cpu, WORD inst);
+void ExecuteFX30(CHIP8 *cpu, WORD inst);
+void ExecuteFX33(CHIP8 *cpu, WORD inst);
+void ExecuteFX55(CHIP8 *cpu, WORD inst);
+void ExecuteFX65(CHIP8 *cpu, WORD inst);
+void ExecuteFX75(CHIP8 *cpu, WORD inst);
+void ExecuteFX85(CHIP8 *cpu, WORD inst);
+
+#endif
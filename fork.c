@@ -0,0 +1,195 @@
+#include <stdlib.h>
+#include <string.h>
+#include "fork.h"
+
+static const BYTE *ChildPage(const Fork *child, int page)
+{
+    return child->pages[page] != NULL ? child->pages[page] : &child->parent->mainMemory[page * MEMORY_PAGE_SIZE];
+}
+
+// Bytes of screenRows worth copying between screens at these resolutions. Words
+// neither of them uses are zero in both
+static size_t ScreenBytes(BYTE hires, BYTE otherHires)
+{
+    return (hires || otherHires ? 2 * HIRES_HEIGHT : SCREEN_HEIGHT) * sizeof(uint64_t);
+}
+
+void ForkMachine(Fork *child, const CHIP8 *parent)
+{
+    memset(child->pages, 0, sizeof(child->pages));
+    child->parent = parent;
+    child->screenRows = NULL;
+    child->hires = parent->hires;
+
+    memcpy(child->dataRegisters, parent->dataRegisters, NUM_REGISTERS);
+    memcpy(child->inputKeys, parent->inputKeys, NUM_KEYS);
+    child->regDT = parent->regDT;
+    child->regST = parent->regST;
+    child->regI = parent->regI;
+    child->PC = parent->PC;
+    child->SP = parent->SP;
+    child->rngState = parent->rngState;
+    memcpy(child->userFlags, parent->userFlags, NUM_USER_FLAGS);
+}
+
+int ForkChild(Fork *child, const Fork *source)
+{
+    int page;
+
+    *child = *source;
+    memset(child->pages, 0, sizeof(child->pages));
+    child->screenRows = NULL;
+
+    for(page = 0; page < MEMORY_PAGES; ++page)
+    {
+        if(source->pages[page] == NULL)
+            continue;
+        if((child->pages[page] = malloc(MEMORY_PAGE_SIZE)) == NULL)
+        {
+            FreeFork(child);
+            return -1;
+        }
+        memcpy(child->pages[page], source->pages[page], MEMORY_PAGE_SIZE);
+    }
+
+    if(source->screenRows != NULL)
+    {
+        if((child->screenRows = calloc(1, sizeof(source->parent->screenRows))) == NULL)
+        {
+            FreeFork(child);
+            return -1;
+        }
+        memcpy(child->screenRows, source->screenRows, ScreenBytes(source->hires, source->hires));
+    }
+
+    return 0;
+}
+
+void FreeFork(Fork *child)
+{
+    int page;
+
+    for(page = 0; page < MEMORY_PAGES; ++page)
+    {
+        free(child->pages[page]);
+        child->pages[page] = NULL;
+    }
+    free(child->screenRows);
+    child->screenRows = NULL;
+}
+
+size_t ForkFootprint(const Fork *child)
+{
+    size_t size = sizeof(Fork);
+    int page;
+
+    for(page = 0; page < MEMORY_PAGES; ++page)
+    {
+        if(child->pages[page] != NULL)
+            size += MEMORY_PAGE_SIZE;
+    }
+    if(child->screenRows != NULL)
+        size += sizeof(child->parent->screenRows);
+
+    return size;
+}
+
+void InitForkRunner(ForkRunner *runner, CHIP8 *cpu)
+{
+    runner->cpu = cpu;
+    runner->parent = NULL;
+    runner->foreignPages = 0;
+    runner->foreignScreen = 0;
+}
+
+void SwapIn(ForkRunner *runner, const Fork *child)
+{
+    CHIP8 *cpu = runner->cpu;
+    WORD restore = runner->foreignPages;
+    int page;
+
+    // A new parent means every page may be foreign
+    if(runner->parent != child->parent)
+    {
+        runner->parent = child->parent;
+        cpu->quirks = child->parent->quirks;
+        restore = 0xFFFF;
+        runner->foreignScreen = 1;
+    }
+
+    // Only pages the last child owned or this one owns can differ. WriteMemory
+    // keeps any decoded code on them coherent
+    runner->foreignPages = 0;
+    for(page = 0; page < MEMORY_PAGES; ++page)
+    {
+        if(child->pages[page] != NULL)
+            runner->foreignPages |= 1 << page;
+        if((restore | runner->foreignPages) & 1 << page)
+            WriteMemory(cpu, page * MEMORY_PAGE_SIZE, ChildPage(child, page), MEMORY_PAGE_SIZE);
+    }
+
+    // A shared screen is at the parent's resolution, as changing it dirties the screen.
+    // Low resolution screens only need their first rows copied
+    if(child->screenRows != NULL || runner->foreignScreen)
+    {
+        memcpy(cpu->screenRows, child->screenRows != NULL ? child->screenRows : child->parent->screenRows,
+               ScreenBytes(cpu->hires, child->hires));
+        runner->foreignScreen = child->screenRows != NULL;
+    }
+    cpu->hires = child->hires;
+
+    memcpy(cpu->dataRegisters, child->dataRegisters, NUM_REGISTERS);
+    memcpy(cpu->inputKeys, child->inputKeys, NUM_KEYS);
+    cpu->regDT = child->regDT;
+    cpu->regST = child->regST;
+    cpu->regI = child->regI;
+    cpu->PC = child->PC;
+    cpu->SP = child->SP;
+    cpu->rngState = child->rngState;
+    memcpy(cpu->userFlags, child->userFlags, NUM_USER_FLAGS);
+
+    // From here on the flags say what the child itself did. The machine is a
+    // different one than any busy-wait loop seen before
+    cpu->dirtyPages = 0;
+    cpu->screenDirty = 0;
+    cpu->idle.target = 0xFFFF;
+}
+
+int SwapOut(ForkRunner *runner, Fork *child)
+{
+    CHIP8 *cpu = runner->cpu;
+    int page;
+
+    for(page = 0; page < MEMORY_PAGES; ++page)
+    {
+        if(!(cpu->dirtyPages & 1 << page))
+            continue;
+        if(child->pages[page] == NULL && (child->pages[page] = malloc(MEMORY_PAGE_SIZE)) == NULL)
+            return -1;
+        memcpy(child->pages[page], &cpu->mainMemory[page * MEMORY_PAGE_SIZE], MEMORY_PAGE_SIZE);
+        runner->foreignPages |= 1 << page;
+    }
+    cpu->dirtyPages = 0;
+
+    if(cpu->screenDirty)
+    {
+        if(child->screenRows == NULL && (child->screenRows = calloc(1, sizeof(cpu->screenRows))) == NULL)
+            return -1;
+        memcpy(child->screenRows, cpu->screenRows, ScreenBytes(cpu->hires, child->hires));
+        runner->foreignScreen = 1;
+        cpu->screenDirty = 0;
+    }
+
+    memcpy(child->dataRegisters, cpu->dataRegisters, NUM_REGISTERS);
+    memcpy(child->inputKeys, cpu->inputKeys, NUM_KEYS);
+    child->regDT = cpu->regDT;
+    child->regST = cpu->regST;
+    child->regI = cpu->regI;
+    child->PC = cpu->PC;
+    child->SP = cpu->SP;
+    child->rngState = cpu->rngState;
+    child->hires = cpu->hires;
+    memcpy(child->userFlags, cpu->userFlags, NUM_USER_FLAGS);
+
+    return 0;
+}
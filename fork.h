@@ -0,0 +1,60 @@
+#ifndef FORK_H
+#define FORK_H
+
+#include <stddef.h>
+#include "chip8core.h"
+
+// A machine forked from a parent state that must outlive it. Memory pages and
+// the screen are shared with the parent until the child first writes them, so
+// a fresh fork is a couple of hundred bytes and costs about as much to make
+//
+// Children don't run by themselves. A ForkRunner swaps one at a time into a
+// real machine, runs it with any engine and the parent's quirks, and swaps it
+// back out, keeping only the pages the run stored to (CHIP8.dirtyPages) or the
+// screen if it changed
+typedef struct Fork
+{
+    const CHIP8 *parent;
+    BYTE *pages[MEMORY_PAGES];  // Private copies, NULL while shared
+    uint64_t *screenRows;       // Private screen, NULL while shared
+    BYTE hires;
+
+    BYTE dataRegisters[NUM_REGISTERS];
+    BYTE inputKeys[NUM_KEYS];
+    BYTE regDT;
+    BYTE regST;
+    WORD regI;
+    WORD PC;
+    WORD SP;
+    uint64_t rngState;
+    BYTE userFlags[NUM_USER_FLAGS];
+} Fork;
+
+// The machine children run on, and what it holds beyond the parent's state
+typedef struct ForkRunner
+{
+    CHIP8 *cpu;
+    const CHIP8 *parent;    // Parent the machine mirrors outside the pages below
+    WORD foreignPages;      // Pages that may differ from the parent's
+    BYTE foreignScreen;     // The screen may differ from the parent's
+} ForkRunner;
+
+// Make child a copy of parent, sharing everything. ForkChild copies a child,
+// giving the copy its own copies of the private pages. Both return non-zero if
+// out of memory
+void ForkMachine(Fork *child, const CHIP8 *parent);
+int ForkChild(Fork *child, const Fork *source);
+void FreeFork(Fork *child);
+
+// Bytes a child holds on its own, counting its private pages
+size_t ForkFootprint(const Fork *child);
+
+// cpu is run by the caller, with whatever engine it was set up with
+void InitForkRunner(ForkRunner *runner, CHIP8 *cpu);
+
+// Load a child into the runner's machine, and write back what running it
+// changed. SwapOut returns non-zero if out of memory
+void SwapIn(ForkRunner *runner, const Fork *child);
+int SwapOut(ForkRunner *runner, Fork *child);
+
+#endif
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chip8core.h"
+
+// Instructions each input runs for. Small enough for hundreds of thousands of
+// runs a second, large enough to get through most ROMs' setup code
+#ifndef FUZZ_CYCLES
+#define FUZZ_CYCLES 4096
+#endif
+
+// One counter per hashed (previous, current) pair of PC and opcode class. The
+// fuzzer finds them in their own section and treats every new non-zero counter
+// as new coverage, the same way it treats edges in the compiled code
+#define EDGE_COUNTERS 0x10000
+
+#if defined(__linux__) && !defined(FUZZ_STANDALONE)
+__attribute__((section("__libfuzzer_extra_counters")))
+#endif
+static BYTE edgeCounters[EDGE_COUNTERS];
+
+// Engines run against the plain interpreter on every input. The AOT engine
+// needs a translated program of its own, so it can't run arbitrary inputs and
+// make check-aot covers it instead
+static const Engine ENGINES[] = { ENGINE_CACHED, ENGINE_JIT };
+
+static void BootInput(CHIP8 *cpu, const BYTE *data, size_t size)
+{
+    memset(cpu, 0, sizeof(CHIP8));
+    memcpy(&cpu->mainMemory[PROGRAM_START], data, size < MAX_ROM_SIZE ? size : MAX_ROM_SIZE);
+    InitializeCPU(cpu);
+
+    // Inputs of different lengths run under different quirk profiles, so every
+    // specialized executor gets fuzzed without changing what a ROM's bytes mean
+    cpu->quirks = size % (QUIRKS_XOCHIP + 1);
+}
+
+// Everything a ROM can observe, which every engine must agree on
+static int SameMachine(const CHIP8 *a, const CHIP8 *b)
+{
+    return memcmp(a->mainMemory, b->mainMemory, MEMORY_SIZE) == 0 &&
+           memcmp(a->dataRegisters, b->dataRegisters, NUM_REGISTERS) == 0 &&
+           memcmp(a->screenRows, b->screenRows, sizeof(a->screenRows)) == 0 &&
+           memcmp(a->userFlags, b->userFlags, NUM_USER_FLAGS) == 0 &&
+           a->regI == b->regI && a->PC == b->PC && a->SP == b->SP &&
+           a->regDT == b->regDT && a->regST == b->regST &&
+           a->hires == b->hires && a->rngState == b->rngState;
+}
+
+// Run one ROM on a fresh machine through the plain interpreter, stepping it by
+// hand so every instruction's edge is seen
+static void RunInput(CHIP8 *cpu, const BYTE *data, size_t size)
+{
+    unsigned int previous = 0;
+    unsigned long cycle;
+
+    BootInput(cpu, data, size);
+
+    for(cycle = 0; cycle < FUZZ_CYCLES; ++cycle)
+    {
+        WORD pc = cpu->PC;
+        WORD inst = Fetch(cpu);
+        unsigned int location = (pc * 0x9E37u ^ inst >> 12) & (EDGE_COUNTERS - 1);
+
+        ++edgeCounters[location ^ previous];
+        previous = location >> 1;
+
+        DecodeExecute(cpu, inst);
+        if(cycle % CYCLES_PER_FRAME == CYCLES_PER_FRAME - 1)
+            StepTimers(cpu);
+    }
+}
+
+// Run the same ROM with engine, skipping busy-wait loops, and crash if it ends
+// anywhere but where the plain interpreter did. The last byte of the input
+// splits every frame into two RunCycles calls, so calls end partway through
+// decoded blocks and fused instructions too
+static void CompareEngine(CHIP8 *cpu, const CHIP8 *reference, Engine engine, const BYTE *data, size_t size)
+{
+    unsigned int split = size != 0 ? data[size - 1] % CYCLES_PER_FRAME : 0;
+    unsigned long cycle;
+
+    BootInput(cpu, data, size);
+    cpu->idleSkip = 1;
+    if(SetEngine(cpu, engine) != 0)
+        return;
+
+    for(cycle = 0; cycle + CYCLES_PER_FRAME <= FUZZ_CYCLES; cycle += CYCLES_PER_FRAME)
+    {
+        RunCycles(cpu, split);
+        RunFrame(cpu, CYCLES_PER_FRAME - split);
+    }
+    RunCycles(cpu, FUZZ_CYCLES - cycle);
+    ReleaseEngine(cpu);
+
+    if(!SameMachine(reference, cpu))
+    {
+        fprintf(stderr, "FUZZ ERROR!\nEngine %d differs from the switch interpreter (PC %03X, expected %03X).\n",
+                (int)engine, cpu->PC, reference->PC);
+        abort();
+    }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static CHIP8 cpu, machine;
+    unsigned int e;
+
+    RunInput(&cpu, data, size);
+    for(e = 0; e < sizeof(ENGINES) / sizeof(ENGINES[0]); ++e)
+        CompareEngine(&machine, &cpu, ENGINES[e], data, size);
+    return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+
+// Without libFuzzer, run every file named on the command line once, for
+// reproducing crashes and for sanitizer builds with compilers that lack it
+int main(int argc, char **argv)
+{
+    static BYTE rom[MAX_ROM_SIZE + 1];
+    size_t edges = 0;
+    int i;
+
+    for(i = 1; i < argc; ++i)
+    {
+        FILE *input;
+        size_t size;
+
+        if((input = fopen(argv[i], "rb")) == NULL)
+        {
+            fprintf(stderr, "FILE I/O ERROR!\nCould not open file \"%s\".", argv[i]);
+            return -1;
+        }
+        size = fread(rom, 1, sizeof(rom), input);
+        fclose(input);
+
+        LLVMFuzzerTestOneInput(rom, size);
+    }
+
+    for(i = 0; i < EDGE_COUNTERS; ++i)
+        edges += edgeCounters[i] != 0;
+    fprintf(stderr, "%d inputs, %lu edges\n", argc - 1, (unsigned long)edges);
+
+    return 0;
+}
+
+#endif
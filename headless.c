@@ -0,0 +1,74 @@
+#include "headless.h"
+
+unsigned long RunHeadless(CHIP8 *cpu, const HeadlessOptions *options)
+{
+    unsigned long cycles = 0;
+    unsigned long frames = 0;
+
+    while((options->maxFrames == 0 || frames < options->maxFrames) &&
+          (options->maxCycles == 0 || cycles < options->maxCycles))
+    {
+        // The last frame may be cut short by the cycle limit
+        unsigned long count = options->cyclesPerFrame;
+        if(options->maxCycles != 0 && options->maxCycles - cycles < count)
+            count = options->maxCycles - cycles;
+
+        RunCycles(cpu, count);
+        cycles += count;
+
+        // Timers only tick at complete frame boundaries
+        if(count == options->cyclesPerFrame)
+        {
+            StepTimers(cpu);
+            ++frames;
+        }
+    }
+
+    return cycles;
+}
+
+// One character per pixel, '#' for lit and '.' for unlit
+void DumpScreen(const CHIP8 *cpu, FILE *output)
+{
+    int width = cpu->hires ? HIRES_WIDTH : SCREEN_WIDTH;
+    int height = cpu->hires ? HIRES_HEIGHT : SCREEN_HEIGHT;
+    int x, y;
+
+    // High resolution rows continue into the word HIRES_HEIGHT further on
+    for(y = 0; y < height; ++y)
+    {
+        for(x = 0; x < width; ++x)
+        {
+            uint64_t bits = cpu->screenRows[y + (x / 64) * HIRES_HEIGHT];
+            fputc((bits << x % 64) >> 63 ? '#' : '.', output);
+        }
+        fputc('\n', output);
+    }
+}
+
+void DumpRegisters(const CHIP8 *cpu, FILE *output)
+{
+    int i;
+
+    for(i = 0; i < NUM_REGISTERS; ++i)
+        fprintf(output, "V%X=%02X ", i, cpu->dataRegisters[i]);
+    fprintf(output, "\nI=%03X PC=%03X SP=%03X DT=%02X ST=%02X\n",
+            cpu->regI, cpu->PC, cpu->SP, cpu->regDT, cpu->regST);
+}
+
+void WriteJSONString(const char *text, FILE *output)
+{
+    fputc('"', output);
+    for(; *text != '\0'; ++text)
+    {
+        unsigned char c = *text;
+
+        if(c == '"' || c == '\\')
+            fprintf(output, "\\%c", c);
+        else if(c < 0x20)
+            fprintf(output, "\\u%04X", c);
+        else
+            fputc(c, output);
+    }
+    fputc('"', output);
+}
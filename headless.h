@@ -0,0 +1,28 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <stdio.h>
+#include "chip8core.h"
+
+// Limits for a headless run. A limit of zero means unlimited, but at least one
+// of maxCycles and maxFrames must be set or the run never ends
+typedef struct HeadlessOptions
+{
+    unsigned long maxCycles;        // Stop after this many instructions
+    unsigned long maxFrames;        // Stop after this many 60Hz frames
+    unsigned int cyclesPerFrame;    // Instructions executed between timer ticks
+} HeadlessOptions;
+
+// Run the machine as fast as the host allows with no video, audio or timer thread.
+// Returns the number of instructions executed
+unsigned long RunHeadless(CHIP8 *cpu, const HeadlessOptions *options);
+
+// Print machine state in a plain text format suited to diffing in CI
+void DumpScreen(const CHIP8 *cpu, FILE *output);
+void DumpRegisters(const CHIP8 *cpu, FILE *output);
+
+// Print text as a quoted JSON string, for tools that report in JSON. Quotes,
+// backslashes (as in Windows paths) and control characters are escaped
+void WriteJSONString(const char *text, FILE *output);
+
+#endif
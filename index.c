@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "catalog.h"
+
+// Largest instructions per frame a catalogue slot holds
+#define MAX_CATALOG_IPF 0xFFFF
+
+// Settings given on the command line, applied to every ROM indexed
+typedef struct Overrides
+{
+    int quirks;                 // -1 to keep the ROM's own
+    unsigned int cyclesPerFrame;// 0 to keep the ROM's own
+    const char *keymap;         // NULL to keep the ROM's own
+} Overrides;
+
+static void ApplyOverrides(CatalogEntry *entry, const Overrides *overrides)
+{
+    if(overrides->quirks >= 0)
+        entry->quirks = overrides->quirks;
+    if(overrides->cyclesPerFrame != 0)
+        entry->cyclesPerFrame = overrides->cyclesPerFrame;
+    if(overrides->keymap != NULL)
+        memcpy(entry->keymap, overrides->keymap, NUM_KEYS);
+}
+
+// Fill overrides from the options before the index file. Returns the index of
+// the first argument after them, or -1 on malformed usage
+static int ParseOverrides(int argc, char **argv, Overrides *overrides)
+{
+    int i;
+
+    overrides->quirks = -1;
+    overrides->cyclesPerFrame = 0;
+    overrides->keymap = NULL;
+
+    for(i = 1; i < argc && argv[i][0] == '-' && argv[i][1] == '-'; i += 2)
+    {
+        if(i + 1 == argc)
+            return -1;
+        if(strcmp(argv[i], "--quirks") == 0)
+        {
+            if((overrides->quirks = FindQuirkProfile(argv[i + 1])) < 0)
+                return -1;
+        }
+        else if(strcmp(argv[i], "--ipf") == 0)
+        {
+            overrides->cyclesPerFrame = strtoul(argv[i + 1], NULL, 0);
+            if(overrides->cyclesPerFrame == 0 || overrides->cyclesPerFrame > MAX_CATALOG_IPF)
+                return -1;
+        }
+        else if(strcmp(argv[i], "--keymap") == 0)
+        {
+            overrides->keymap = argv[i + 1];
+            if(strlen(overrides->keymap) != NUM_KEYS || !IsKeymap(overrides->keymap))
+                return -1;
+        }
+        else
+            return -1;
+    }
+
+    return i;
+}
+
+int main(int argc, char **argv)
+{
+    static BYTE rom[MAX_CATALOG_ROM_SIZE];
+    Overrides overrides;
+    const char *indexPath;
+    Catalog catalog;
+    int hashed = 0, unchanged = 0, failed = 0;
+    int i;
+
+    if((i = ParseOverrides(argc, argv, &overrides)) < 0 || argc - i < 2)
+    {
+        fprintf(stderr, "USAGE ERROR!\nCorrect Usage: chip8-index [--quirks modern|vip|chip48|schip|xochip] [--ipf <n>] [--keymap <16 keys>] <index-file> <rom-file>...");
+        return -1;
+    }
+    indexPath = argv[i++];
+
+    // A catalogue that doesn't exist yet starts empty. One that can't be read is
+    // left alone rather than overwritten
+    InitCatalog(&catalog);
+    if(LoadCatalog(&catalog, indexPath) != 0)
+    {
+        FILE *existing = fopen(indexPath, "rb");
+        if(existing != NULL)
+        {
+            fclose(existing);
+            fprintf(stderr, "CATALOG ERROR!\n\"%s\" is not a ROM catalogue.", indexPath);
+            return -1;
+        }
+    }
+
+    for(; i < argc; ++i)
+    {
+        CatalogPath *last = FindPath(&catalog, HashPath(argv[i]));
+        CatalogEntry *found = NULL;
+        CatalogEntry entry;
+        CatalogPath file;
+        struct stat info;
+        size_t size;
+
+        if(stat(argv[i], &info) != 0)
+        {
+            fprintf(stderr, "FILE I/O ERROR!\nCould not open file \"%s\".\n", argv[i]);
+            ++failed;
+            continue;
+        }
+
+        // The same file at the same size and time is taken to hold the same ROM
+        if(last != NULL && last->modified == (int64_t)info.st_mtime && last->size == (uint64_t)info.st_size)
+            found = FindEntry(&catalog, last->hash);
+        if(found != NULL)
+        {
+            ApplyOverrides(found, &overrides);
+            ++unchanged;
+            continue;
+        }
+
+        if(ReadROMFile(argv[i], rom, sizeof(rom), &size) != 0)
+        {
+            fprintf(stderr, "FILE I/O ERROR!\nCould not read \"%s\" as a ROM of at most %d bytes.\n", argv[i], MAX_CATALOG_ROM_SIZE);
+            ++failed;
+            continue;
+        }
+
+        // A ROM already known under another name or an older time keeps its settings
+        entry.hash = HashROM(rom, size);
+        if((found = FindEntry(&catalog, entry.hash)) != NULL)
+            entry = *found;
+        else
+        {
+            entry.platform = DetectPlatform(rom, size);
+            DefaultSettings(&entry);
+        }
+        entry.pathHash = HashPath(argv[i]);
+        entry.modified = info.st_mtime;
+        entry.size = size;
+        ApplyOverrides(&entry, &overrides);
+
+        file.pathHash = entry.pathHash;
+        file.hash = entry.hash;
+        file.modified = entry.modified;
+        file.size = size;
+        if(AddEntry(&catalog, &entry) != 0 || AddPath(&catalog, &file) != 0)
+        {
+            fprintf(stderr, "MEMORY ERROR!\nCould not index \"%s\".", argv[i]);
+            return -1;
+        }
+        printf("%016llx %6lu %-6s %4u %s\n", (unsigned long long)entry.hash, (unsigned long)size,
+               PlatformName(entry.platform), entry.cyclesPerFrame, argv[i]);
+        ++hashed;
+    }
+
+    if(SaveCatalog(&catalog, indexPath) != 0)
+    {
+        fprintf(stderr, "FILE I/O ERROR!\nCould not write \"%s\".", indexPath);
+        return -1;
+    }
+    fprintf(stderr, "%d ROMs hashed, %d unchanged, %d unreadable, %lu in \"%s\"\n", hashed, unchanged, failed,
+            (unsigned long)catalog.count, indexPath);
+
+    FreeCatalog(&catalog);
+    return failed != 0 ? -1 : 0;
+}
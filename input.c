@@ -0,0 +1,90 @@
+#include "input.h"
+
+void InitInputQueue(InputQueue *queue)
+{
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    queue->dropped = 0;
+}
+
+int PushKey(InputQueue *queue, uint64_t time, BYTE key, BYTE pressed)
+{
+    unsigned int head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    KeyEvent *event;
+
+    if(head - tail == INPUT_QUEUE_SIZE)
+    {
+        ++queue->dropped;
+        return -1;
+    }
+
+    // Fill the slot before publishing it
+    event = &queue->events[head & (INPUT_QUEUE_SIZE - 1)];
+    event->time = time;
+    event->key = key & (NUM_KEYS - 1);
+    event->pressed = pressed;
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+
+    return 0;
+}
+
+// Oldest event, or NULL if there are none. It stays valid until PopKey
+static const KeyEvent *PeekKey(InputQueue *queue)
+{
+    unsigned int tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+
+    if(atomic_load_explicit(&queue->head, memory_order_acquire) == tail)
+        return NULL;
+    return &queue->events[tail & (INPUT_QUEUE_SIZE - 1)];
+}
+
+// Hand the oldest slot back to the producer
+static void PopKey(InputQueue *queue)
+{
+    unsigned int tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+}
+
+int RunQueuedFrame(CHIP8 *cpu, unsigned int cyclesPerFrame, InputQueue *queue,
+                   uint64_t start, uint64_t end, Movie *record)
+{
+    const KeyEvent *event;
+    unsigned int done = 0;
+
+    while((event = PeekKey(queue)) != NULL && event->time <= end)
+    {
+        // Anything from before the frame, say while it was paused, goes first.
+        // Events are applied in queue order even if their times are not
+        unsigned int cycle = 0;
+        if(event->time > start)
+            cycle = (event->time - start) * cyclesPerFrame / (end - start);
+
+        if(cycle > done)
+        {
+            RunCycles(cpu, cycle - done);
+            done = cycle;
+        }
+
+        cpu->inputKeys[event->key] = event->pressed ? 0xFF : 0x00;
+        PopKey(queue);
+        if(record != NULL && RecordKeys(record, cpu, done) != 0)
+            return -1;
+    }
+
+    RunCycles(cpu, cyclesPerFrame - done);
+    StepTimers(cpu);
+
+    return 0;
+}
+
+void DrainKeys(CHIP8 *cpu, InputQueue *queue)
+{
+    const KeyEvent *event;
+
+    while((event = PeekKey(queue)) != NULL)
+    {
+        cpu->inputKeys[event->key] = event->pressed ? 0xFF : 0x00;
+        PopKey(queue);
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdatomic.h>
+#include "chip8core.h"
+#include "movie.h"
+
+// Key transitions waiting to be applied. Must be a power of two
+#define INPUT_QUEUE_SIZE 256
+
+typedef struct KeyEvent
+{
+    uint64_t time;      // When it happened, on whatever clock the frame bounds use
+    BYTE key;           // 0x0 - 0xF
+    BYTE pressed;       // Non-zero for a press, zero for a release
+} KeyEvent;
+
+// Single-producer, single-consumer ring. One thread pushes, another runs the
+// machine, and neither ever waits on the other. Indices count up forever and
+// are masked on use, so head - tail is always the number queued
+typedef struct InputQueue
+{
+    KeyEvent events[INPUT_QUEUE_SIZE];
+    atomic_uint head;           // Written only by the producer
+    atomic_uint tail;           // Written only by the consumer
+    unsigned long dropped;      // Events lost to a full queue, producer side
+} InputQueue;
+
+void InitInputQueue(InputQueue *queue);
+
+// Producer side. Returns non-zero, dropping the event, if the queue is full
+int PushKey(InputQueue *queue, uint64_t time, BYTE key, BYTE pressed);
+
+// Consumer side. Run one frame spanning start to end on the producer's clock.
+// Each event up to end is applied at the cycle its time falls on, and later
+// events wait for the next frame. When record is set the changes are logged
+// to it. Returns non-zero if recording ran out of memory
+int RunQueuedFrame(CHIP8 *cpu, unsigned int cyclesPerFrame, InputQueue *queue,
+                   uint64_t start, uint64_t end, Movie *record);
+
+// Apply everything queued at once, for when the machine isn't running
+void DrainKeys(CHIP8 *cpu, InputQueue *queue);
+
+#endif
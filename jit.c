@@ -0,0 +1,386 @@
+#include <stdlib.h>
+#include <string.h>
+#include "jit.h"
+#include "profile.h"
+#include "quirks.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#ifdef _WIN32
+#include <windows.h>
+#define BASE 1  // rcx holds the CHIP8 pointer under the Windows x64 convention
+#else
+#include <sys/mman.h>
+#define BASE 7  // rdi holds the CHIP8 pointer under the System V convention
+#endif
+
+#define BUFFER_SIZE (1 << 20)
+#define MAX_BLOCK 64        // Longest run of instructions translated as one block
+#define MAX_EMIT 64         // Upper bound on native bytes emitted per instruction
+
+// x86 register numbers for the scratch registers. Both are caller-saved everywhere
+#define AL 0
+#define DL 2
+
+// Offsets of machine state from BASE
+#define V(n)    (offsetof(CHIP8, dataRegisters) + (n))
+#define REG_I   offsetof(CHIP8, regI)
+#define REG_PC  offsetof(CHIP8, PC)
+#define REG_DT  offsetof(CHIP8, regDT)
+#define REG_ST  offsetof(CHIP8, regST)
+
+typedef struct Emitter
+{
+    BYTE *code;
+    size_t length;
+} Emitter;
+
+static void Byte(Emitter *e, BYTE b)
+{
+    e->code[e->length++] = b;
+}
+
+static void Word(Emitter *e, WORD w)
+{
+    Byte(e, w & 0xFF);
+    Byte(e, w >> 8);
+}
+
+// ModRM and displacement for [BASE + offset], with reg in the middle field
+static void Mem(Emitter *e, int reg, size_t offset)
+{
+    Byte(e, 0x80 | reg << 3 | BASE);
+    Byte(e, offset & 0xFF);
+    Byte(e, (offset >> 8) & 0xFF);
+    Byte(e, (offset >> 16) & 0xFF);
+    Byte(e, (offset >> 24) & 0xFF);
+}
+
+// op r8, [BASE + offset] or op [BASE + offset], r8 depending on the opcode
+static void Op(Emitter *e, BYTE opcode, int reg, size_t offset)
+{
+    Byte(e, opcode);
+    Mem(e, reg, offset);
+}
+
+// mov word [PC], value. PC wraps at the top of memory as in the interpreter
+static void SetPC(Emitter *e, WORD value)
+{
+    Byte(e, 0x66);
+    Op(e, 0xC7, 0, REG_PC);
+    Word(e, value & ADDRESS_MASK);
+}
+
+// VF is written from DL, then Vx = a op b is computed again. Mirrors the core
+// executors, which set VF before updating Vx even when x is F
+static void ArithmeticWithFlag(Emitter *e, BYTE setcc, BYTE op, int x, int a, int b)
+{
+    Op(e, 0x8A, AL, V(a));      // mov al, [Va]
+    Op(e, op == 0x02 ? 0x02 : 0x3A, AL, V(b));  // add al, [Vb] / cmp al, [Vb]
+    Byte(e, 0x0F);              // setc dl / seta dl
+    Byte(e, setcc);
+    Byte(e, 0xC0 | DL);
+    Op(e, 0x88, DL, V(0xF));    // mov [VF], dl
+    Op(e, 0x8A, AL, V(a));      // mov al, [Va]
+    Op(e, op, AL, V(b));        // add / sub al, [Vb]
+    Op(e, 0x88, AL, V(x));      // mov [Vx], al
+}
+
+// Skip instructions end a block. PC becomes next, or next + 2 if the comparison
+// left ZF equal to skipIfEqual
+static void Skip(Emitter *e, WORD next, int skipIfEqual)
+{
+    SetPC(e, next);
+    Byte(e, skipIfEqual ? 0x75 : 0x74);     // jne / je over the second store
+    Byte(e, 9);
+    SetPC(e, next + 2);
+    Byte(e, 0xC3);                          // ret
+}
+
+// Emit native code for inst at addr. Returns 0 if the instruction is not handled,
+// 1 if the block continues and 2 if the instruction ended the block
+static int Translate(Emitter *e, WORD inst, WORD addr)
+{
+    int x = (inst & 0x0F00) >> 8;
+    int y = (inst & 0x00F0) >> 4;
+    BYTE nn = inst & 0x00FF;
+    WORD nnn = inst & 0x0FFF;
+    WORD next = addr + 2;
+
+    switch(inst & 0xF000)
+    {
+        case 0x1000:
+            SetPC(e, nnn);
+            Byte(e, 0xC3);
+            return 2;
+        case 0x3000:
+        case 0x4000:
+            Byte(e, 0x80);                  // cmp byte [Vx], nn
+            Mem(e, 7, V(x));
+            Byte(e, nn);
+            Skip(e, next, (inst & 0xF000) == 0x3000);
+            return 2;
+        case 0x5000:
+        case 0x9000:
+            if((inst & 0x000F) != 0)
+                return 0;
+            Op(e, 0x8A, AL, V(x));          // mov al, [Vx]
+            Op(e, 0x3A, AL, V(y));          // cmp al, [Vy]
+            Skip(e, next, (inst & 0xF000) == 0x5000);
+            return 2;
+        case 0x6000:
+            Op(e, 0xC6, 0, V(x));           // mov byte [Vx], nn
+            Byte(e, nn);
+            return 1;
+        case 0x7000:
+            Op(e, 0x80, 0, V(x));           // add byte [Vx], nn
+            Byte(e, nn);
+            return 1;
+        case 0x8000:
+            switch(inst & 0x000F)
+            {
+                case 0x0000:
+                    Op(e, 0x8A, AL, V(y));  // mov al, [Vy]
+                    Op(e, 0x88, AL, V(x));  // mov [Vx], al
+                    return 1;
+                case 0x0001:
+                case 0x0002:
+                case 0x0003:
+                    Op(e, 0x8A, AL, V(y));  // mov al, [Vy]
+                    Op(e, (inst & 0x000F) == 1 ? 0x08 : (inst & 0x000F) == 2 ? 0x20 : 0x30, AL, V(x));
+                    return 1;
+                case 0x0004:
+                    ArithmeticWithFlag(e, 0x92, 0x02, x, x, y);
+                    return 1;
+                case 0x0005:
+                    ArithmeticWithFlag(e, 0x97, 0x2A, x, x, y);
+                    return 1;
+                case 0x0007:
+                    ArithmeticWithFlag(e, 0x97, 0x2A, x, y, x);
+                    return 1;
+                default:
+                    return 0;
+            }
+        case 0xA000:
+            Byte(e, 0x66);                  // mov word [I], nnn
+            Op(e, 0xC7, 0, REG_I);
+            Word(e, nnn);
+            return 1;
+        case 0xF000:
+            switch(inst & 0x00FF)
+            {
+                case 0x0007:
+                    Op(e, 0x8A, AL, REG_DT);    // mov al, [DT]
+                    Op(e, 0x88, AL, V(x));      // mov [Vx], al
+                    return 1;
+                case 0x0015:
+                case 0x0018:
+                    Op(e, 0x8A, AL, V(x));      // mov al, [Vx]
+                    Op(e, 0x88, AL, nn == 0x15 ? REG_DT : REG_ST);
+                    return 1;
+                case 0x001E:
+                    Byte(e, 0x0F);              // movzx eax, byte [Vx]
+                    Op(e, 0xB6, AL, V(x));
+                    Byte(e, 0x66);              // add word [I], ax
+                    Op(e, 0x01, AL, REG_I);
+                    return 1;
+                default:
+                    return 0;
+            }
+        default:
+            return 0;
+    }
+}
+
+static void FlushJIT(JITCache *jit)
+{
+    memset(jit->blocks, 0, sizeof(jit->blocks));
+    memset(jit->codeMap, 0, sizeof(jit->codeMap));
+    jit->used = 0;
+}
+
+// The buffer is writable while blocks are emitted and executable while they
+// run, never both at once, as hardened hosts require. Returns non-zero if the
+// host refuses
+static int Protect(JITCache *jit, BYTE writable)
+{
+#ifdef _WIN32
+    DWORD previous;
+#endif
+
+    if(jit->writable == writable)
+        return 0;
+#ifdef _WIN32
+    if(!VirtualProtect(jit->buffer, BUFFER_SIZE, writable ? PAGE_READWRITE : PAGE_EXECUTE_READ, &previous))
+        return -1;
+#else
+    if(mprotect(jit->buffer, BUFFER_SIZE, writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC) != 0)
+        return -1;
+#endif
+    jit->writable = writable;
+    return 0;
+}
+
+// Translate the run of instructions starting at start into a new block
+static void TranslateBlock(CHIP8 *cpu, JITCache *jit, WORD start)
+{
+    JITBlock *block = &jit->blocks[start];
+    Emitter e;
+    WORD addr = start;
+    int count = 0;
+    int result = 1;
+
+    block->tried = 1;
+    if(Protect(jit, 1) != 0)
+        return;
+
+    // Make room for a worst case block
+    if(jit->used + MAX_BLOCK * MAX_EMIT > BUFFER_SIZE)
+        FlushJIT(jit);
+
+    e.code = jit->buffer + jit->used;
+    e.length = 0;
+
+    while(result == 1 && count < MAX_BLOCK && addr < MEMORY_SIZE - 1)
+    {
+        WORD inst = cpu->mainMemory[addr] << 8 | cpu->mainMemory[addr + 1];
+
+        result = Translate(&e, inst, addr);
+        if(result == 0)
+            break;
+
+        ++count;
+        addr += 2;
+    }
+
+    // Nothing at the start address could be translated. The interpreter handles it
+    if(count == 0)
+        return;
+
+    // A block that runs into an unhandled instruction hands it to the interpreter
+    if(result != 2)
+    {
+        SetPC(&e, addr);
+        Byte(&e, 0xC3);
+    }
+
+    memset(&jit->codeMap[start], 1, addr - start);
+    // ISO C has no cast from data to function pointers, so copy the bits over
+    memcpy(&block->code, &e.code, sizeof(block->code));
+    block->count = count;
+    jit->used += (e.length + 15) & ~(size_t)15;
+}
+
+JITCache *CreateJITCache(void)
+{
+    JITCache *jit = calloc(1, sizeof(JITCache));
+
+    if(jit == NULL)
+        return NULL;
+
+#ifdef _WIN32
+    jit->buffer = VirtualAlloc(NULL, BUFFER_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+    jit->buffer = mmap(NULL, BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(jit->buffer == MAP_FAILED)
+        jit->buffer = NULL;
+#endif
+    jit->writable = 1;
+
+    // Find out now, rather than at the first block, if the host never lets
+    // the buffer run
+    if(jit->buffer == NULL || Protect(jit, 0) != 0)
+    {
+        if(jit->buffer != NULL)
+            DestroyJITCache(jit);
+        else
+            free(jit);
+        return NULL;
+    }
+
+    return jit;
+}
+
+void DestroyJITCache(JITCache *jit)
+{
+#ifdef _WIN32
+    VirtualFree(jit->buffer, 0, MEM_RELEASE);
+#else
+    munmap(jit->buffer, BUFFER_SIZE);
+#endif
+    free(jit);
+}
+
+void InvalidateJIT(JITCache *jit, WORD addr)
+{
+    // Self-modifying code is rare, so dropping everything keeps blocks simple
+    if(jit->codeMap[addr & ADDRESS_MASK])
+        FlushJIT(jit);
+}
+
+void RunCyclesJIT(CHIP8 *cpu, unsigned long count)
+{
+    JITCache *jit = cpu->jitCache;
+    DecodeFunction decode = SelectDecodeExecute(cpu->quirks);
+
+    while(count > 0)
+    {
+        JITBlock *block = &jit->blocks[cpu->PC & ADDRESS_MASK];
+
+        if(!block->tried && cpu->PC < MEMORY_SIZE)
+            TranslateBlock(cpu, jit, cpu->PC);
+
+        // Blocks that would overrun the budget are interpreted one step at a time
+        WORD pc = cpu->PC;
+
+        if(block->code != NULL && block->count <= count && Protect(jit, 0) == 0)
+        {
+            PROFILE_BLOCK(cpu, pc, block->count);
+            block->code(cpu);
+            count -= block->count;
+
+            // Only the last instruction of a block can branch. Moving back to or
+            // before it may have closed a busy-wait loop
+            if(cpu->PC <= pc + 2 * (block->count - 1))
+                count -= IdleSkip(cpu, count);
+        }
+        else
+        {
+            PROFILE_INSTRUCTION(cpu, pc);
+            decode(cpu, Fetch(cpu));
+            --count;
+
+            if(cpu->PC <= pc)
+                count -= IdleSkip(cpu, count);
+        }
+    }
+}
+
+#else
+
+// No translator for this host. SetEngine reports the failure
+JITCache *CreateJITCache(void)
+{
+    return NULL;
+}
+
+void DestroyJITCache(JITCache *jit)
+{
+}
+
+void InvalidateJIT(JITCache *jit, WORD addr)
+{
+}
+
+void RunCyclesJIT(CHIP8 *cpu, unsigned long count)
+{
+    DecodeFunction decode = SelectDecodeExecute(cpu->quirks);
+
+    while(count-- > 0)
+    {
+        PROFILE_INSTRUCTION(cpu, cpu->PC);
+        decode(cpu, Fetch(cpu));
+    }
+}
+
+#endif
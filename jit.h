@@ -0,0 +1,37 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stddef.h>
+#include "chip8core.h"
+
+// Native code for one straight-line run of chip8 instructions. Running it leaves
+// the machine exactly where DecodeExecute would after count instructions
+typedef struct JITBlock
+{
+    void (*code)(CHIP8 *cpu);   // NULL if the address has not been translated
+    WORD count;                 // Instructions the block executes
+    BYTE tried;                 // Translation was attempted, even if it failed
+} JITBlock;
+
+// Translated blocks keyed by start address, and the code buffer they live in
+typedef struct JITCache
+{
+    JITBlock blocks[MEMORY_SIZE];
+    BYTE codeMap[MEMORY_SIZE];  // Non-zero for bytes covered by some translated block
+    BYTE *buffer;
+    size_t used;
+    BYTE writable;              // The buffer is mapped for writing rather than running
+} JITCache;
+
+// Returns NULL when the host is not x86-64 or executable memory is unavailable
+JITCache *CreateJITCache(void);
+void DestroyJITCache(JITCache *jit);
+
+// Throw away every block if the byte at addr was translated
+void InvalidateJIT(JITCache *jit, WORD addr);
+
+// Execute count instructions, translating blocks as they are reached and
+// interpreting anything the translator does not handle
+void RunCyclesJIT(CHIP8 *cpu, unsigned long count);
+
+#endif
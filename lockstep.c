@@ -0,0 +1,470 @@
+#include <stdlib.h>
+#include <string.h>
+#include "lockstep.h"
+
+// Non-zero for the instructions that reach past VX, VY, V0 and VF, which all
+// work on V0 through VX: FX55, FX65, FX75 and FX85
+static int TouchesRegisterRange(WORD inst)
+{
+    switch(inst & 0xF0FF)
+    {
+        case 0xF055: case 0xF065: case 0xF075: case 0xF085:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// Copy the registers inst can touch between the group's arrays and a lane's
+// machine
+static void GatherLane(Lockstep *group, unsigned int lane, WORD inst)
+{
+    CHIP8 *cpu = &group->machines[lane];
+    unsigned int x = (inst & 0x0F00) >> 8;
+    unsigned int r;
+
+    if(TouchesRegisterRange(inst))
+    {
+        for(r = 0; r <= x; ++r)
+            cpu->dataRegisters[r] = group->dataRegisters[r][lane];
+    }
+    else
+    {
+        cpu->dataRegisters[x] = group->dataRegisters[x][lane];
+        cpu->dataRegisters[(inst & 0x00F0) >> 4] = group->dataRegisters[(inst & 0x00F0) >> 4][lane];
+        cpu->dataRegisters[0x0] = group->dataRegisters[0x0][lane];
+        cpu->dataRegisters[0xF] = group->dataRegisters[0xF][lane];
+    }
+    cpu->regI = group->regI[lane];
+    cpu->PC = group->PC[lane];
+    cpu->regDT = group->regDT[lane];
+    cpu->regST = group->regST[lane];
+    cpu->rngState = group->rngState[lane];
+}
+
+static void ScatterLane(Lockstep *group, unsigned int lane, WORD inst)
+{
+    const CHIP8 *cpu = &group->machines[lane];
+    unsigned int x = (inst & 0x0F00) >> 8;
+    unsigned int r;
+
+    if(TouchesRegisterRange(inst))
+    {
+        for(r = 0; r <= x; ++r)
+            group->dataRegisters[r][lane] = cpu->dataRegisters[r];
+    }
+    else
+    {
+        group->dataRegisters[x][lane] = cpu->dataRegisters[x];
+        group->dataRegisters[(inst & 0x00F0) >> 4][lane] = cpu->dataRegisters[(inst & 0x00F0) >> 4];
+        group->dataRegisters[0x0][lane] = cpu->dataRegisters[0x0];
+        group->dataRegisters[0xF][lane] = cpu->dataRegisters[0xF];
+    }
+    group->regI[lane] = cpu->regI;
+    group->PC[lane] = cpu->PC;
+    group->regDT[lane] = cpu->regDT;
+    group->regST[lane] = cpu->regST;
+    group->rngState[lane] = cpu->rngState;
+}
+
+// One instruction on one lane through the core interpreter
+static void ExecuteLane(Lockstep *group, unsigned int lane, WORD inst)
+{
+    CHIP8 *cpu = &group->machines[lane];
+
+    GatherLane(group, lane, inst);
+    DecodeExecute(cpu, Fetch(cpu));
+    ScatterLane(group, lane, inst);
+}
+
+#ifdef __GNUC__
+
+// One element per lane. Comparisons yield the signed types, all ones where true
+typedef BYTE ByteLanes __attribute__((vector_size(LOCKSTEP_LANES)));
+typedef signed char ByteMask __attribute__((vector_size(LOCKSTEP_LANES)));
+typedef WORD WordLanes __attribute__((vector_size(LOCKSTEP_LANES * 2)));
+typedef short WordMask __attribute__((vector_size(LOCKSTEP_LANES * 2)));
+typedef uint64_t LongLanes __attribute__((vector_size(LOCKSTEP_LANES * 8)));
+typedef long long LongMask __attribute__((vector_size(LOCKSTEP_LANES * 8)));
+
+// Loads, and stores that only touch lanes set in mask. memcpy keeps them free
+// of alignment and aliasing trouble and compiles to plain vector moves. Word
+// lanes are wider than the SSE registers every x86-64 host has, and would be
+// passed differently under AVX, so they only ever go by pointer
+static inline ByteLanes LoadBytes(const BYTE *lanes)
+{
+    ByteLanes value;
+    memcpy(&value, lanes, sizeof(value));
+    return value;
+}
+
+static inline void LoadWords(WordLanes *value, const WORD *lanes)
+{
+    memcpy(value, lanes, sizeof(*value));
+}
+
+static inline void StoreBytes(BYTE *lanes, ByteLanes value, ByteMask mask)
+{
+    value = (LoadBytes(lanes) & ~(ByteLanes)mask) | (value & (ByteLanes)mask);
+    memcpy(lanes, &value, sizeof(value));
+}
+
+static inline void StoreWords(WORD *lanes, const WordLanes *value, const WordMask *mask)
+{
+    WordLanes stored;
+
+    LoadWords(&stored, lanes);
+    stored = (stored & ~(WordLanes)*mask) | (*value & (WordLanes)*mask);
+    memcpy(lanes, &stored, sizeof(stored));
+}
+
+// Widen a byte value per lane to a word
+static inline void WidenBytes(WordLanes *wide, ByteLanes value)
+{
+    *wide = __builtin_convertvector(value, WordLanes);
+}
+
+// Run inst on every lane in mask, all of which are at the same PC. Mirrors the
+// core executors, including the order registers are read and written in, so
+// overlapping operands such as VF behave the same. Returns zero, having done
+// nothing, for instructions that touch memory, keys or the screen, or whose
+// meaning depends on the platform
+static int ExecuteGroup(Lockstep *group, WORD inst, ByteMask mask)
+{
+    WordMask wordMask = __builtin_convertvector(mask, WordMask);
+    unsigned int x = (inst & 0x0F00) >> 8;
+    unsigned int y = (inst & 0x00F0) >> 4;
+    BYTE nn = inst & 0x00FF;
+    WORD nnn = inst & 0x0FFF;
+    BYTE (*V)[LOCKSTEP_LANES] = group->dataRegisters;
+    WordLanes pc, value;
+    ByteLanes vx, vy;
+
+    LoadWords(&pc, group->PC);
+    pc += 2;
+
+    switch(inst & 0xF000)
+    {
+        case 0x1000:
+            pc = (WordLanes){0} + nnn;
+            break;
+        case 0x3000:
+            WidenBytes(&value, (ByteLanes)(LoadBytes(V[x]) == nn));
+            pc += value & 2;
+            break;
+        case 0x4000:
+            WidenBytes(&value, (ByteLanes)(LoadBytes(V[x]) != nn));
+            pc += value & 2;
+            break;
+        case 0x5000:
+            if((inst & 0xF) != 0)
+                return 0;
+            WidenBytes(&value, (ByteLanes)(LoadBytes(V[x]) == LoadBytes(V[y])));
+            pc += value & 2;
+            break;
+        case 0x6000:
+            StoreBytes(V[x], (ByteLanes){0} + nn, mask);
+            break;
+        case 0x7000:
+            StoreBytes(V[x], LoadBytes(V[x]) + nn, mask);
+            break;
+        case 0x8000:
+            switch(inst & 0xF)
+            {
+                case 0x0:
+                    StoreBytes(V[x], LoadBytes(V[y]), mask);
+                    break;
+                case 0x1:
+                    StoreBytes(V[x], LoadBytes(V[x]) | LoadBytes(V[y]), mask);
+                    break;
+                case 0x2:
+                    StoreBytes(V[x], LoadBytes(V[x]) & LoadBytes(V[y]), mask);
+                    break;
+                case 0x3:
+                    StoreBytes(V[x], LoadBytes(V[x]) ^ LoadBytes(V[y]), mask);
+                    break;
+                case 0x4:
+                    vx = LoadBytes(V[x]);
+                    vy = LoadBytes(V[y]);
+                    StoreBytes(V[0xF], (ByteLanes)(vx + vy < vx) & 1, mask);
+                    StoreBytes(V[x], LoadBytes(V[x]) + LoadBytes(V[y]), mask);
+                    break;
+                case 0x5:
+                    vx = LoadBytes(V[x]);
+                    vy = LoadBytes(V[y]);
+                    StoreBytes(V[0xF], (ByteLanes)(vx > vy) & 1, mask);
+                    StoreBytes(V[x], LoadBytes(V[x]) - LoadBytes(V[y]), mask);
+                    break;
+                case 0x7:
+                    vx = LoadBytes(V[x]);
+                    vy = LoadBytes(V[y]);
+                    StoreBytes(V[0xF], (ByteLanes)(vy > vx) & 1, mask);
+                    StoreBytes(V[x], LoadBytes(V[y]) - LoadBytes(V[x]), mask);
+                    break;
+                default:
+                    return 0;
+            }
+            break;
+        case 0x9000:
+            if((inst & 0xF) != 0)
+                return 0;
+            WidenBytes(&value, (ByteLanes)(LoadBytes(V[x]) != LoadBytes(V[y])));
+            pc += value & 2;
+            break;
+        case 0xA000:
+            value = (WordLanes){0} + nnn;
+            StoreWords(group->regI, &value, &wordMask);
+            break;
+        case 0xC000:
+        {
+            // xorshift64* per lane, as in ExecuteCXNN
+            LongMask longMask = __builtin_convertvector(mask, LongMask);
+            LongLanes state, old;
+
+            memcpy(&old, group->rngState, sizeof(old));
+            state = old;
+            state ^= state >> 12;
+            state ^= state << 25;
+            state ^= state >> 27;
+            state = (old & ~(LongLanes)longMask) | (state & (LongLanes)longMask);
+            memcpy(group->rngState, &state, sizeof(state));
+
+            StoreBytes(V[x], __builtin_convertvector(state * 0x2545F4914F6CDD1DULL >> 56, ByteLanes) & nn, mask);
+            break;
+        }
+        case 0xF000:
+            switch(inst & 0xFF)
+            {
+                case 0x07:
+                    StoreBytes(V[x], LoadBytes(group->regDT), mask);
+                    break;
+                case 0x15:
+                    StoreBytes(group->regDT, LoadBytes(V[x]), mask);
+                    break;
+                case 0x18:
+                    StoreBytes(group->regST, LoadBytes(V[x]), mask);
+                    break;
+                case 0x1E:
+                {
+                    WordLanes regI;
+
+                    LoadWords(&regI, group->regI);
+                    WidenBytes(&value, LoadBytes(V[x]));
+                    value += regI;
+                    StoreWords(group->regI, &value, &wordMask);
+                    break;
+                }
+                default:
+                    return 0;
+            }
+            break;
+        default:
+            return 0;
+    }
+
+    pc &= ADDRESS_MASK;
+    StoreWords(group->PC, &pc, &wordMask);
+    return 1;
+}
+
+#else
+
+// Without vector extensions every lane runs on its own
+typedef BYTE ByteMask[LOCKSTEP_LANES];
+
+static int ExecuteGroup(Lockstep *group, WORD inst, const BYTE *mask)
+{
+    return 0;
+}
+
+#endif
+
+Lockstep *CreateLockstep(const CHIP8 *boot, unsigned int lanes)
+{
+    Lockstep *group;
+    unsigned int i;
+
+    if(lanes == 0 || lanes > LOCKSTEP_LANES || (group = calloc(1, sizeof(Lockstep))) == NULL)
+        return NULL;
+
+    group->lanes = lanes;
+    for(i = 0; i < lanes; ++i)
+        LoadLane(group, i, boot);
+    return group;
+}
+
+void DestroyLockstep(Lockstep *group)
+{
+    free(group);
+}
+
+void LoadLane(Lockstep *group, unsigned int lane, const CHIP8 *cpu)
+{
+    CHIP8 *machine = &group->machines[lane];
+    int r;
+
+    *machine = *cpu;
+
+    // Lanes are only ever run through DecodeExecute, so they keep no engine
+    // state, and nothing is profiled or fast-forwarded
+    machine->engine = ENGINE_SWITCH;
+    machine->decodeCache = NULL;
+    machine->jitCache = NULL;
+    machine->aotCache = NULL;
+    machine->profile = NULL;
+    machine->idleSkip = 0;
+
+    for(r = 0; r < NUM_REGISTERS; ++r)
+        group->dataRegisters[r][lane] = cpu->dataRegisters[r];
+    group->regI[lane] = cpu->regI;
+    group->PC[lane] = cpu->PC;
+    group->regDT[lane] = cpu->regDT;
+    group->regST[lane] = cpu->regST;
+    group->rngState[lane] = cpu->rngState;
+}
+
+void StoreLane(const Lockstep *group, unsigned int lane, CHIP8 *cpu)
+{
+    int r;
+
+    *cpu = group->machines[lane];
+    for(r = 0; r < NUM_REGISTERS; ++r)
+        cpu->dataRegisters[r] = group->dataRegisters[r][lane];
+    cpu->regI = group->regI[lane];
+    cpu->PC = group->PC[lane];
+    cpu->regDT = group->regDT[lane];
+    cpu->regST = group->regST[lane];
+    cpu->rngState = group->rngState[lane];
+}
+
+// Non-zero when every lane is at the same PC and about to run the same instruction
+static int InStep(const Lockstep *group)
+{
+    WORD pc = group->PC[0];
+    const BYTE *code = group->machines[0].mainMemory;
+    int same = 1;
+    unsigned int lane;
+
+    for(lane = 1; lane < group->lanes; ++lane)
+    {
+        const BYTE *memory = group->machines[lane].mainMemory;
+        same &= group->PC[lane] == pc &&
+                memory[pc & ADDRESS_MASK] == code[pc & ADDRESS_MASK] &&
+                memory[(pc + 1) & ADDRESS_MASK] == code[(pc + 1) & ADDRESS_MASK];
+    }
+    return same;
+}
+
+// Run the instruction at the shared PC on every lane in mask
+static void ExecuteMembers(Lockstep *group, WORD pc, const BYTE *code, ByteMask mask, unsigned int members)
+{
+    WORD inst = code[pc & ADDRESS_MASK] << 8 | code[(pc + 1) & ADDRESS_MASK];
+    unsigned int lane;
+
+    if(members > 1 && ExecuteGroup(group, inst, mask))
+    {
+        ++group->vectorSteps;
+        return;
+    }
+
+    for(lane = 0; lane < group->lanes; ++lane)
+    {
+        if(mask[lane])
+        {
+            ExecuteLane(group, lane, inst);
+            ++group->scalarSteps;
+        }
+    }
+}
+
+void RunLockstep(Lockstep *group, unsigned long count)
+{
+    unsigned long remaining[LOCKSTEP_LANES] = {0};
+    ByteMask all;
+    unsigned int lane;
+
+    for(lane = 0; lane < LOCKSTEP_LANES; ++lane)
+        all[lane] = lane < group->lanes ? -1 : 0;
+
+    while(count > 0)
+    {
+        // While every lane is in step, the whole group runs each instruction
+        while(count > 0 && InStep(group))
+        {
+            ExecuteMembers(group, group->PC[0], group->machines[0].mainMemory, all, group->lanes);
+            --count;
+        }
+        if(count == 0)
+            break;
+
+        // Otherwise the lane furthest behind leads, and every lane just as far
+        // behind and about to run the same instruction joins it, until all of
+        // them are back in step or out of cycles
+        for(lane = 0; lane < group->lanes; ++lane)
+            remaining[lane] = count;
+
+        for(;;)
+        {
+            unsigned int leader = 0;
+            unsigned int members = 0;
+            unsigned long least = count;
+            ByteMask mask;
+            const BYTE *code;
+            WORD pc;
+
+            for(lane = 1; lane < group->lanes; ++lane)
+            {
+                if(remaining[lane] > remaining[leader])
+                    leader = lane;
+                if(remaining[lane] < least)
+                    least = remaining[lane];
+            }
+            if(remaining[0] < least)
+                least = remaining[0];
+
+            // Everyone caught up, so the fast path can take over again
+            if(remaining[leader] == least && least > 0 && InStep(group))
+            {
+                count = least;
+                break;
+            }
+            if(remaining[leader] == 0)
+            {
+                count = 0;
+                break;
+            }
+
+            pc = group->PC[leader];
+            code = group->machines[leader].mainMemory;
+            for(lane = 0; lane < LOCKSTEP_LANES; ++lane)
+            {
+                const BYTE *memory = group->machines[lane].mainMemory;
+                int member = lane < group->lanes && remaining[lane] == remaining[leader] &&
+                             group->PC[lane] == pc &&
+                             memory[pc & ADDRESS_MASK] == code[pc & ADDRESS_MASK] &&
+                             memory[(pc + 1) & ADDRESS_MASK] == code[(pc + 1) & ADDRESS_MASK];
+
+                mask[lane] = member ? -1 : 0;
+                members += member;
+            }
+            for(lane = 0; lane < group->lanes; ++lane)
+                remaining[lane] -= mask[lane] != 0;
+
+            ExecuteMembers(group, pc, code, mask, members);
+        }
+    }
+}
+
+void RunLockstepFrame(Lockstep *group, unsigned int cyclesPerFrame)
+{
+    unsigned int lane;
+
+    RunLockstep(group, cyclesPerFrame);
+    for(lane = 0; lane < group->lanes; ++lane)
+    {
+        if(group->regDT[lane] > 0)
+            --group->regDT[lane];
+        if(group->regST[lane] > 0)
+            --group->regST[lane];
+    }
+}
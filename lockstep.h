@@ -0,0 +1,49 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include "chip8core.h"
+
+// Machines run side by side by one lockstep group
+#define LOCKSTEP_LANES 16
+
+// A group of machines, usually booted from the same ROM, run one instruction at
+// a time across all lanes. Registers live here in structure-of-arrays form
+// (dataRegisters[r][lane]) so an instruction that every lane agrees on runs as
+// a handful of vector operations. Memory, the stack, keys and the screen stay
+// in one CHIP8 per lane, and instructions that touch them run lane by lane
+//
+// Lanes that branch apart are regrouped by PC every step, furthest behind first,
+// so they drift back into step whenever their paths meet again
+typedef struct Lockstep
+{
+    BYTE dataRegisters[NUM_REGISTERS][LOCKSTEP_LANES];
+    WORD regI[LOCKSTEP_LANES];
+    WORD PC[LOCKSTEP_LANES];
+    BYTE regDT[LOCKSTEP_LANES];
+    BYTE regST[LOCKSTEP_LANES];
+    uint64_t rngState[LOCKSTEP_LANES];
+
+    // Everything else about each lane. The registers above are the live ones,
+    // and are only copied in here while a lane runs on its own
+    CHIP8 machines[LOCKSTEP_LANES];
+    unsigned int lanes;
+
+    // Instructions run across a whole group at once, and lane by lane
+    unsigned long vectorSteps;
+    unsigned long scalarSteps;
+} Lockstep;
+
+// Start with every lane a copy of boot. Returns NULL if out of memory
+Lockstep *CreateLockstep(const CHIP8 *boot, unsigned int lanes);
+void DestroyLockstep(Lockstep *group);
+
+// Copy a machine into a lane, or a lane out into a machine
+void LoadLane(Lockstep *group, unsigned int lane, const CHIP8 *cpu);
+void StoreLane(const Lockstep *group, unsigned int lane, CHIP8 *cpu);
+
+// Every lane executes count instructions, exactly as RunCycles would without
+// idle skipping
+void RunLockstep(Lockstep *group, unsigned long count);
+void RunLockstepFrame(Lockstep *group, unsigned int cyclesPerFrame);
+
+#endif
@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "movie.h"
+
+// 64-bit FNV-1a prime, applied a row at a time
+#define HASH_PRIME 0x100000001B3ULL
+
+#define HEADER_SIZE 36
+#define EVENT_SIZE 10
+#define EVENT_SIZE_V2 6
+
+uint64_t HashScreen(uint64_t hash, const CHIP8 *cpu)
+{
+    int i;
+
+    // Low resolution screens hash exactly as before high resolution existed, so
+    // recorded checksums stay valid
+    for(i = 0; i < SCREEN_WORDS(cpu); ++i)
+        hash = (hash ^ cpu->screenRows[i]) * HASH_PRIME;
+    return hash;
+}
+
+static void PutLong(BYTE *buffer, uint64_t value, int size)
+{
+    int i;
+
+    for(i = 0; i < size; ++i)
+        buffer[i] = value >> (i * 8);
+}
+
+static uint64_t GetLong(const BYTE *buffer, int size)
+{
+    uint64_t value = 0;
+    int i;
+
+    for(i = 0; i < size; ++i)
+        value |= (uint64_t)buffer[i] << (i * 8);
+    return value;
+}
+
+void InitMovie(Movie *movie, uint64_t seed, unsigned int cyclesPerFrame, QuirkProfile quirks)
+{
+    movie->seed = seed;
+    movie->cyclesPerFrame = cyclesPerFrame;
+    movie->quirks = quirks;
+    movie->frames = 0;
+    movie->screenHash = SCREEN_HASH_BASIS;
+    movie->events = NULL;
+    movie->count = 0;
+    movie->capacity = 0;
+}
+
+void FreeMovie(Movie *movie)
+{
+    free(movie->events);
+    movie->events = NULL;
+    movie->count = movie->capacity = 0;
+}
+
+WORD GetKeyMask(const CHIP8 *cpu)
+{
+    WORD keys = 0;
+    int i;
+
+    for(i = 0; i < NUM_KEYS; ++i)
+    {
+        if(cpu->inputKeys[i])
+            keys |= 1 << i;
+    }
+    return keys;
+}
+
+void SetKeyMask(CHIP8 *cpu, WORD keys)
+{
+    int i;
+
+    for(i = 0; i < NUM_KEYS; ++i)
+        cpu->inputKeys[i] = keys >> i & 1 ? 0xFF : 0x00;
+}
+
+int RecordKeys(Movie *movie, const CHIP8 *cpu, unsigned int cycle)
+{
+    WORD keys = GetKeyMask(cpu);
+    MovieEvent *last = movie->count > 0 ? &movie->events[movie->count - 1] : NULL;
+
+    if(keys == (last != NULL ? last->keys : 0))
+        return 0;
+
+    // Several changes on the same instruction only need the final state
+    if(last != NULL && last->frame == movie->frames && last->cycle == cycle)
+    {
+        last->keys = keys;
+        return 0;
+    }
+
+    if(movie->count == movie->capacity)
+    {
+        size_t capacity = movie->capacity > 0 ? movie->capacity * 2 : 256;
+        MovieEvent *events = realloc(movie->events, capacity * sizeof(MovieEvent));
+
+        if(events == NULL)
+            return -1;
+        movie->events = events;
+        movie->capacity = capacity;
+    }
+
+    movie->events[movie->count].frame = movie->frames;
+    movie->events[movie->count].cycle = cycle;
+    movie->events[movie->count].keys = keys;
+    ++movie->count;
+    return 0;
+}
+
+void RecordFrame(Movie *movie, const CHIP8 *cpu)
+{
+    movie->screenHash = HashScreen(movie->screenHash, cpu);
+    ++movie->frames;
+}
+
+uint64_t ReplayMovie(CHIP8 *cpu, const Movie *movie)
+{
+    uint64_t hash = SCREEN_HASH_BASIS;
+    unsigned long frame;
+    size_t next = 0;
+
+    SetKeyMask(cpu, 0);
+    for(frame = 0; frame < movie->frames; ++frame)
+    {
+        unsigned int done = 0;
+
+        // Split the frame wherever the keys changed, as RunQueuedFrame did
+        while(next < movie->count && movie->events[next].frame == frame)
+        {
+            if(movie->events[next].cycle > done)
+            {
+                RunCycles(cpu, movie->events[next].cycle - done);
+                done = movie->events[next].cycle;
+            }
+            SetKeyMask(cpu, movie->events[next++].keys);
+        }
+
+        RunCycles(cpu, movie->cyclesPerFrame - done);
+        StepTimers(cpu);
+        hash = HashScreen(hash, cpu);
+    }
+
+    return hash;
+}
+
+int SaveMovie(const Movie *movie, const char *path)
+{
+    BYTE buffer[HEADER_SIZE];
+    FILE *output;
+    size_t i;
+    int result = 0;
+
+    if((output = fopen(path, "wb")) == NULL)
+        return -1;
+
+    memcpy(buffer, MOVIE_MAGIC, 4);
+    PutLong(&buffer[4], MOVIE_VERSION, 2);
+    PutLong(&buffer[6], movie->quirks, 1);
+    PutLong(&buffer[7], 0, 1);
+    PutLong(&buffer[8], movie->seed, 8);
+    PutLong(&buffer[16], movie->cyclesPerFrame, 4);
+    PutLong(&buffer[20], movie->frames, 4);
+    PutLong(&buffer[24], movie->count, 4);
+    PutLong(&buffer[28], movie->screenHash, 8);
+    if(fwrite(buffer, HEADER_SIZE, 1, output) != 1)
+        result = -1;
+
+    for(i = 0; i < movie->count && result == 0; ++i)
+    {
+        PutLong(&buffer[0], movie->events[i].frame, 4);
+        PutLong(&buffer[4], movie->events[i].cycle, 4);
+        PutLong(&buffer[8], movie->events[i].keys, 2);
+        if(fwrite(buffer, EVENT_SIZE, 1, output) != 1)
+            result = -1;
+    }
+
+    if(fclose(output) != 0)
+        result = -1;
+    return result;
+}
+
+int LoadMovie(Movie *movie, const char *path)
+{
+    BYTE buffer[HEADER_SIZE];
+    FILE *input;
+    size_t i, count;
+    int version;
+
+    if((input = fopen(path, "rb")) == NULL)
+        return -1;
+
+    if(fread(buffer, HEADER_SIZE, 1, input) != 1 || memcmp(buffer, MOVIE_MAGIC, 4) != 0 ||
+       (version = GetLong(&buffer[4], 2)) < 2 || version > MOVIE_VERSION ||
+       (version == MOVIE_VERSION && buffer[6] > QUIRKS_XOCHIP))
+    {
+        fclose(input);
+        return -1;
+    }
+
+    InitMovie(movie, GetLong(&buffer[8], 8), GetLong(&buffer[16], 4), buffer[6]);
+    if(version < MOVIE_VERSION)
+        movie->quirks = -1;
+    movie->frames = GetLong(&buffer[20], 4);
+    movie->screenHash = GetLong(&buffer[28], 8);
+    count = GetLong(&buffer[24], 4);
+
+    movie->events = malloc((count > 0 ? count : 1) * sizeof(MovieEvent));
+    if(movie->events == NULL || movie->cyclesPerFrame == 0)
+    {
+        FreeMovie(movie);
+        fclose(input);
+        return -1;
+    }
+    movie->capacity = count;
+
+    for(i = 0; i < count; ++i)
+    {
+        if(fread(buffer, version == 2 ? EVENT_SIZE_V2 : EVENT_SIZE, 1, input) != 1)
+        {
+            FreeMovie(movie);
+            fclose(input);
+            return -1;
+        }
+
+        movie->events[i].frame = GetLong(&buffer[0], 4);
+        if(version == 2)
+        {
+            movie->events[i].cycle = 0;
+            movie->events[i].keys = GetLong(&buffer[4], 2);
+        }
+        else
+        {
+            movie->events[i].cycle = GetLong(&buffer[4], 4);
+            movie->events[i].keys = GetLong(&buffer[8], 2);
+        }
+
+        // A replay can't run a frame backwards
+        if(movie->events[i].cycle > movie->cyclesPerFrame)
+        {
+            FreeMovie(movie);
+            fclose(input);
+            return -1;
+        }
+    }
+    movie->count = count;
+
+    fclose(input);
+    return 0;
+}
@@ -0,0 +1,72 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <stddef.h>
+#include "chip8core.h"
+
+// A recorded session: the random seed, and the key state at every point where
+// it changed, down to the instruction. Replaying the log from the same starting
+// state reproduces the run exactly. screenHash folds in the screen after every
+// frame, which lets a replay prove it matched bit for bit
+//
+// On disk, little-endian:
+//
+//   "C8MV", version (4), quirk profile (1), reserved (1), seed (8),
+//   cyclesPerFrame (4), frames (4), event count (4), screenHash (8), then per
+//   event the frame number (4), the cycle within it (4) and the 16-key mask
+//   (2), bit n set when key n is held. Versions 2 and 3 had no profile, and
+//   version 2 had no cycle, its keys changing between frames
+#define MOVIE_MAGIC "C8MV"
+#define MOVIE_VERSION 4
+
+// Screen hashes start from this and fold in one screen at a time
+#define SCREEN_HASH_BASIS 0xCBF29CE484222325ULL
+
+typedef struct MovieEvent
+{
+    unsigned long frame;    // Frame the keys are held from
+    unsigned int cycle;     // Instructions into that frame, at most cyclesPerFrame
+    WORD keys;              // Bit n set when key n is held
+} MovieEvent;
+
+typedef struct Movie
+{
+    uint64_t seed;          // Passed to SeedRandom before the first frame
+    unsigned int cyclesPerFrame;
+    int quirks;             // QuirkProfile recorded under, -1 if the file predates them
+    unsigned long frames;   // Frames recorded
+    uint64_t screenHash;    // Hash of the screen after each of those frames
+
+    MovieEvent *events;
+    size_t count;
+    size_t capacity;
+} Movie;
+
+// Start an empty recording. Free it with FreeMovie
+void InitMovie(Movie *movie, uint64_t seed, unsigned int cyclesPerFrame, QuirkProfile quirks);
+void FreeMovie(Movie *movie);
+
+// Fold the current screen into a running hash
+uint64_t HashScreen(uint64_t hash, const CHIP8 *cpu);
+
+// Key state as a bit mask, and back
+WORD GetKeyMask(const CHIP8 *cpu);
+void SetKeyMask(CHIP8 *cpu, WORD keys);
+
+// Recording. Call RecordKeys whenever the keys change, with the number of
+// instructions run so far this frame, and RecordFrame after each frame.
+// Returns non-zero when out of memory
+int RecordKeys(Movie *movie, const CHIP8 *cpu, unsigned int cycle);
+void RecordFrame(Movie *movie, const CHIP8 *cpu);
+
+// Run a recording on a machine in its starting state, feeding it the logged
+// keys. The caller seeds the machine from movie->seed and sets its quirks
+// first, unless it starts from a save state, which carries both. Returns the hash of
+// the frames played, which matches screenHash if the replay was exact
+uint64_t ReplayMovie(CHIP8 *cpu, const Movie *movie);
+
+// Movie files. Return non-zero on I/O errors or a malformed file
+int SaveMovie(const Movie *movie, const char *path);
+int LoadMovie(Movie *movie, const char *path);
+
+#endif
@@ -0,0 +1,171 @@
+#include <stdlib.h>
+#include "profile.h"
+
+// Hot addresses listed in a report
+#define HOT_PCS 16
+
+static const char *CLASS_NAMES[NUM_OPCODE_CLASSES] =
+{
+    "00E0", "00EE", "0NNN", "1NNN", "2NNN", "3XNN", "4XNN", "5XY0",
+    "6XNN", "7XNN", "8XY0", "8XY1", "8XY2", "8XY3", "8XY4", "8XY5",
+    "8XY6", "8XY7", "8XYE", "9XY0", "ANNN", "BNNN", "CXNN", "DXYN",
+    "EX9E", "EXA1", "FX07", "FX0A", "FX15", "FX18", "FX1E", "FX29",
+    "FX33", "FX55", "FX65", "00CN", "00FB", "00FC", "00FD", "00FE",
+    "00FF", "FX30", "FX75", "FX85", "????"
+};
+
+static const char *PHASE_NAMES[NUM_PHASES] = { "events", "execute", "draw", "wait" };
+
+// Index into CLASS_NAMES for an opcode, following the dispatch in DecodeExecute
+static int OpcodeClass(WORD inst)
+{
+    const int UNKNOWN = NUM_OPCODE_CLASSES - 1;
+
+    switch(inst >> 12)
+    {
+        case 0x0:
+            if(inst >= 0x00FB && inst <= 0x00FF)
+                return 36 + (inst - 0x00FB);
+            if((inst & 0xFFF0) == 0x00C0)
+                return 35;
+            return inst == 0x00E0 ? 0 : inst == 0x00EE ? 1 : 2;
+        case 0x8:
+            switch(inst & 0xF)
+            {
+                case 0x0: case 0x1: case 0x2: case 0x3:
+                case 0x4: case 0x5: case 0x6: case 0x7:
+                    return 10 + (inst & 0xF);
+                case 0xE:
+                    return 18;
+                default:
+                    return UNKNOWN;
+            }
+        case 0xE:
+            return (inst & 0xFF) == 0x9E ? 24 : (inst & 0xFF) == 0xA1 ? 25 : UNKNOWN;
+        case 0xF:
+            switch(inst & 0xFF)
+            {
+                case 0x07: return 26;
+                case 0x0A: return 27;
+                case 0x15: return 28;
+                case 0x18: return 29;
+                case 0x1E: return 30;
+                case 0x29: return 31;
+                case 0x33: return 32;
+                case 0x55: return 33;
+                case 0x65: return 34;
+                case 0x30: return 41;
+                case 0x75: return 42;
+                case 0x85: return 43;
+                default: return UNKNOWN;
+            }
+        case 0x5:
+        case 0x9:
+            if((inst & 0xF) != 0)
+                return UNKNOWN;
+            return (inst >> 12) == 0x5 ? 7 : 19;
+        default:
+            // 1NNN - 7XNN and ANNN - DXYN are one class per leading nibble
+            return (inst >> 12) < 0x8 ? 2 + (inst >> 12) : 10 + (inst >> 12);
+    }
+}
+
+Profile *CreateProfile(uint64_t tickFrequency)
+{
+    Profile *profile = calloc(1, sizeof(Profile));
+
+    if(profile != NULL)
+        profile->tickFrequency = tickFrequency > 0 ? tickFrequency : 1;
+    return profile;
+}
+
+void DestroyProfile(Profile *profile)
+{
+    free(profile);
+}
+
+void ProfileInstruction(Profile *profile, const BYTE *memory, WORD pc)
+{
+    WORD inst;
+
+    pc &= ADDRESS_MASK;
+    inst = memory[pc] << 8 | memory[(pc + 1) & ADDRESS_MASK];
+    ++profile->classCounts[OpcodeClass(inst)];
+    ++profile->pcCounts[pc];
+}
+
+void ProfileBlock(Profile *profile, const BYTE *memory, WORD pc, unsigned int count)
+{
+    while(count-- > 0)
+    {
+        ProfileInstruction(profile, memory, pc);
+        pc += 2;
+    }
+}
+
+void ProfileLap(Profile *profile, ProfilePhase phase, uint64_t *mark, uint64_t now)
+{
+    profile->frameTicks[phase] += now - *mark;
+    *mark = now;
+}
+
+void ProfileEndFrame(Profile *profile)
+{
+    int i;
+
+    for(i = 0; i < NUM_PHASES; ++i)
+    {
+        profile->totalTicks[i] += profile->frameTicks[i];
+        if(profile->frameTicks[i] > profile->worstTicks[i])
+            profile->worstTicks[i] = profile->frameTicks[i];
+        profile->frameTicks[i] = 0;
+    }
+    ++profile->frames;
+}
+
+void DumpProfile(const Profile *profile, FILE *output)
+{
+    unsigned long long total = 0;
+    WORD hot[HOT_PCS];
+    int hotCount = 0;
+    int i, j;
+
+    for(i = 0; i < NUM_OPCODE_CLASSES; ++i)
+        total += profile->classCounts[i];
+
+    fprintf(output, "PROFILE: %llu instructions\n", total);
+    for(i = 0; i < NUM_OPCODE_CLASSES; ++i)
+    {
+        if(profile->classCounts[i] > 0)
+            fprintf(output, "  %s %14llu %6.2f%%\n", CLASS_NAMES[i], profile->classCounts[i],
+                    100.0 * profile->classCounts[i] / total);
+    }
+
+    // Insertion sort keeps the busiest HOT_PCS addresses, busiest first
+    for(i = 0; i < MEMORY_SIZE; ++i)
+    {
+        if(profile->pcCounts[i] == 0)
+            continue;
+        if(hotCount == HOT_PCS && profile->pcCounts[i] <= profile->pcCounts[hot[HOT_PCS - 1]])
+            continue;
+
+        j = hotCount < HOT_PCS ? hotCount++ : HOT_PCS - 1;
+        for(; j > 0 && profile->pcCounts[hot[j - 1]] < profile->pcCounts[i]; --j)
+            hot[j] = hot[j - 1];
+        hot[j] = i;
+    }
+    fprintf(output, "Hot PCs:\n");
+    for(i = 0; i < hotCount; ++i)
+        fprintf(output, "  %03X %14llu %6.2f%%\n", hot[i], profile->pcCounts[hot[i]],
+                100.0 * profile->pcCounts[hot[i]] / total);
+
+    // Headless runs have no frontend frames to time
+    if(profile->frames == 0)
+        return;
+
+    fprintf(output, "Frame phases over %lu frames (average / worst, ms):\n", profile->frames);
+    for(i = 0; i < NUM_PHASES; ++i)
+        fprintf(output, "  %-8s %8.3f / %8.3f\n", PHASE_NAMES[i],
+                1000.0 * profile->totalTicks[i] / profile->tickFrequency / profile->frames,
+                1000.0 * profile->worstTicks[i] / profile->tickFrequency);
+}
@@ -0,0 +1,70 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+#include "chip8core.h"
+
+// Number of opcode classes counted, one per executor plus unknown opcodes
+#define NUM_OPCODE_CLASSES 45
+
+// Parts of a frontend frame that are timed separately
+typedef enum ProfilePhase
+{
+    PHASE_EVENTS,   // SDL_PollEvent and input handling
+    PHASE_EXECUTE,  // RunFrame
+    PHASE_DRAW,     // Draw
+    PHASE_WAIT,     // Sleeping until the next frame
+    NUM_PHASES
+} ProfilePhase;
+
+// Counters gathered while CHIP8.profile is set. Instructions skipped by IdleSkip
+// never execute, so they are not counted
+typedef struct Profile
+{
+    unsigned long long classCounts[NUM_OPCODE_CLASSES];
+    unsigned long long pcCounts[MEMORY_SIZE];
+
+    // Phase times are in ticks of tickFrequency per second. frameTicks collects
+    // the frame in progress and is folded into the totals by ProfileEndFrame
+    uint64_t tickFrequency;
+    uint64_t frameTicks[NUM_PHASES];
+    uint64_t totalTicks[NUM_PHASES];
+    uint64_t worstTicks[NUM_PHASES];
+    unsigned long frames;
+} Profile;
+
+Profile *CreateProfile(uint64_t tickFrequency);
+void DestroyProfile(Profile *profile);
+
+// Count the instruction at pc, or a straight-line run of count instructions from pc
+void ProfileInstruction(Profile *profile, const BYTE *memory, WORD pc);
+void ProfileBlock(Profile *profile, const BYTE *memory, WORD pc, unsigned int count);
+
+// Charge the time since *mark to phase and move *mark up to now
+void ProfileLap(Profile *profile, ProfilePhase phase, uint64_t *mark, uint64_t now);
+void ProfileEndFrame(Profile *profile);
+
+// Human readable report of everything counted so far
+void DumpProfile(const Profile *profile, FILE *output);
+
+// Instrumentation in the interpreters goes through these, so a build without
+// CHIP8_PROFILE carries no trace of it
+#ifdef CHIP8_PROFILE
+#define PROFILE_INSTRUCTION(cpu, pc)                                        \
+    do                                                                      \
+    {                                                                       \
+        if((cpu)->profile != NULL)                                          \
+            ProfileInstruction((cpu)->profile, (cpu)->mainMemory, (pc));    \
+    } while(0)
+#define PROFILE_BLOCK(cpu, pc, count)                                       \
+    do                                                                      \
+    {                                                                       \
+        if((cpu)->profile != NULL)                                          \
+            ProfileBlock((cpu)->profile, (cpu)->mainMemory, (pc), (count)); \
+    } while(0)
+#else
+#define PROFILE_INSTRUCTION(cpu, pc) ((void)0)
+#define PROFILE_BLOCK(cpu, pc, count) ((void)0)
+#endif
+
+#endif
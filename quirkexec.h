@@ -0,0 +1,189 @@
+// Quirk-dependent executors and the switch interpreter for one profile. Included
+// by chip8core.c once per profile with QUIRK_PROFILE defined, see quirks.h, so
+// this header deliberately has no include guard
+
+// 8XY6 - SHR Vx {, Vy} : Set Vx to Vx >> 1, or Vy >> 1 with QUIRK_SHIFT_VY
+void QUIRKED(Execute8XY6)(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    unsigned int y = (inst & 0x00F0) >> 4;
+    BYTE value = cpu->dataRegisters[QUIRK_MASK & QUIRK_SHIFT_VY ? y : x];
+
+    // Set VF to the bit shifted out, then store the result
+    cpu->dataRegisters[0xF] = value & 0x01;
+    cpu->dataRegisters[x] = value >> 1;
+}
+
+// 8XYE - SHL Vx {, Vy} : Set Vx to Vx << 1, or Vy << 1 with QUIRK_SHIFT_VY
+void QUIRKED(Execute8XYE)(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    unsigned int y = (inst & 0x00F0) >> 4;
+    BYTE value = cpu->dataRegisters[QUIRK_MASK & QUIRK_SHIFT_VY ? y : x];
+
+    cpu->dataRegisters[0xF] = value >> 7;
+    cpu->dataRegisters[x] = value << 1;
+}
+
+// BNNN - JP V0, addr : Jump to address NNN + V0, or XNN + VX with QUIRK_JUMP_VX
+void QUIRKED(ExecuteBNNN)(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = QUIRK_MASK & QUIRK_JUMP_VX ? (inst & 0x0F00) >> 8 : 0;
+    int n = inst & 0x0FFF;
+    cpu->PC = (n + cpu->dataRegisters[x]) & ADDRESS_MASK;
+}
+
+// DXYN - DRW Vx, Vy, N : Draw N BYTE sprite from memory at regI to screen data starting
+// at position Vx, Vy. DXY0 draws a 16x16 sprite
+void QUIRKED(ExecuteDXYN)(CHIP8 *cpu, WORD inst)
+{
+    unsigned int regX = (inst & 0x0F00) >> 8;
+    unsigned int regY = (inst & 0x00F0) >> 4;
+    unsigned int startX = cpu->dataRegisters[regX] % SCREEN_WIDTH;
+    unsigned int startY = cpu->dataRegisters[regY] % SCREEN_HEIGHT;
+    unsigned int height = inst & 0x000F;
+
+    uint64_t collision = 0; // Lit pixels the sprite turned off
+    uint64_t flipped = 0;   // Every pixel the sprite touched
+    unsigned int line;
+
+    // High resolution and 16x16 sprites take the slower general path
+    if(cpu->hires || height == 0)
+    {
+        DrawExtended(cpu, inst, QUIRK_MASK & QUIRK_WRAP_SPRITES);
+        return;
+    }
+
+    // The start position always wraps. Without QUIRK_WRAP_SPRITES sprites are
+    // clipped at the bottom edge...
+    if(!(QUIRK_MASK & QUIRK_WRAP_SPRITES) && height > SCREEN_HEIGHT - startY)
+        height = SCREEN_HEIGHT - startY;
+
+    for(line = 0; line < height; ++line)
+    {
+        uint64_t sprite = (uint64_t)cpu->mainMemory[(cpu->regI + line) & ADDRESS_MASK] << (SCREEN_WIDTH - SPRITE_WIDTH);
+        unsigned int row = (startY + line) % SCREEN_HEIGHT;
+
+        // ...and at the right edge, where the shift pushes bits past column 63
+        // out of the row. Wrapping rotates them round to column 0 instead
+        if((QUIRK_MASK & QUIRK_WRAP_SPRITES) && startX != 0)
+            sprite = sprite >> startX | sprite << (SCREEN_WIDTH - startX);
+        else
+            sprite >>= startX;
+
+        collision |= cpu->screenRows[row] & sprite;
+        cpu->screenRows[row] ^= sprite;
+        flipped |= sprite;
+    }
+
+    cpu->dataRegisters[0xF] = collision != 0;
+    cpu->screenDirty |= flipped != 0;
+    ++cpu->writeCount;
+}
+
+// FX55 - LD [I], Vx : Store registers V0 through Vx into memory at regI
+void QUIRKED(ExecuteFX55)(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    int i;
+
+    for(i = 0; i <= x; ++i)
+        StoreByte(cpu, cpu->regI + i, cpu->dataRegisters[i]);
+
+    if(QUIRK_MASK & QUIRK_LOAD_ADVANCE)
+        cpu->regI += x + 1;
+    else if(QUIRK_MASK & QUIRK_LOAD_ADVANCE_X)
+        cpu->regI += x;
+}
+
+// FX65 - LD Vx, [I] : Load registers V0 through Vx from memory at regI
+void QUIRKED(ExecuteFX65)(CHIP8 *cpu, WORD inst)
+{
+    unsigned int x = (inst & 0x0F00) >> 8;
+    int i;
+
+    for(i = 0; i <= x; ++i)
+        cpu->dataRegisters[i] = cpu->mainMemory[(cpu->regI + i) & ADDRESS_MASK];
+
+    if(QUIRK_MASK & QUIRK_LOAD_ADVANCE)
+        cpu->regI += x + 1;
+    else if(QUIRK_MASK & QUIRK_LOAD_ADVANCE_X)
+        cpu->regI += x;
+}
+
+// Same decoding as Decode8000 and DecodeF000, calling this profile's executors
+static inline void QUIRKED(Decode8000)(CHIP8 *cpu, WORD inst)
+{
+    switch(inst & 0x000F)
+    {
+        case 0x0000: Execute8XY0(cpu, inst); break;
+        case 0x0001: Execute8XY1(cpu, inst); break;
+        case 0x0002: Execute8XY2(cpu, inst); break;
+        case 0x0003: Execute8XY3(cpu, inst); break;
+        case 0x0004: Execute8XY4(cpu, inst); break;
+        case 0x0005: Execute8XY5(cpu, inst); break;
+        case 0x0006: QUIRKED(Execute8XY6)(cpu, inst); break;
+        case 0x0007: Execute8XY7(cpu, inst); break;
+        case 0x000E: QUIRKED(Execute8XYE)(cpu, inst); break;
+        default: break;
+    }
+}
+
+static inline void QUIRKED(DecodeF000)(CHIP8 *cpu, WORD inst)
+{
+    switch(inst & 0x00FF)
+    {
+        case 0x0007: ExecuteFX07(cpu, inst); break;
+        case 0x000A: ExecuteFX0A(cpu, inst); break;
+        case 0x0015: ExecuteFX15(cpu, inst); break;
+        case 0x0018: ExecuteFX18(cpu, inst); break;
+        case 0x001E: ExecuteFX1E(cpu, inst); break;
+        case 0x0029: ExecuteFX29(cpu, inst); break;
+        case 0x0030: ExecuteFX30(cpu, inst); break;
+        case 0x0033: ExecuteFX33(cpu, inst); break;
+        case 0x0055: QUIRKED(ExecuteFX55)(cpu, inst); break;
+        case 0x0065: QUIRKED(ExecuteFX65)(cpu, inst); break;
+        case 0x0075: ExecuteFX75(cpu, inst); break;
+        case 0x0085: ExecuteFX85(cpu, inst); break;
+        default: break;
+    }
+}
+
+void QUIRKED(DecodeExecute)(CHIP8 *cpu, WORD inst)
+{
+    switch(inst & 0xF000)
+    {
+        case 0x0000: Decode0000(cpu, inst);  break;
+        case 0x1000: Execute1NNN(cpu, inst); break;
+        case 0x2000: Execute2NNN(cpu, inst); break;
+        case 0x3000: Execute3XNN(cpu, inst); break;
+        case 0x4000: Execute4XNN(cpu, inst); break;
+        case 0x5000: Execute5XY0(cpu, inst); break;
+        case 0x6000: Execute6XNN(cpu, inst); break;
+        case 0x7000: Execute7XNN(cpu, inst); break;
+        case 0x8000: QUIRKED(Decode8000)(cpu, inst);  break;
+        case 0x9000: Execute9XY0(cpu, inst); break;
+        case 0xA000: ExecuteANNN(cpu, inst); break;
+        case 0xB000: QUIRKED(ExecuteBNNN)(cpu, inst); break;
+        case 0xC000: ExecuteCXNN(cpu, inst); break;
+        case 0xD000: QUIRKED(ExecuteDXYN)(cpu, inst); break;
+        case 0xE000: DecodeE000(cpu, inst);  break;
+        case 0xF000: QUIRKED(DecodeF000)(cpu, inst);  break;
+        default: break;
+    }
+}
+
+// The ENGINE_SWITCH loop of RunCycles
+void QUIRKED(RunCyclesSwitch)(CHIP8 *cpu, unsigned long count)
+{
+    while(count-- > 0)
+    {
+        WORD pc = cpu->PC;
+        PROFILE_INSTRUCTION(cpu, pc);
+        QUIRKED(DecodeExecute)(cpu, Fetch(cpu));
+
+        // Control moved backwards, which may have closed a busy-wait loop
+        if(cpu->PC <= pc)
+            count -= IdleSkip(cpu, count);
+    }
+}
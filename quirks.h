@@ -0,0 +1,68 @@
+#ifndef QUIRKS_H
+#define QUIRKS_H
+
+#include "chip8core.h"
+
+// Behaviours that differ between chip8 implementations. A profile is a fixed
+// set of these, see QUIRK_MASK_*
+#define QUIRK_SHIFT_VY      0x01    // 8XY6/8XYE shift Vy into Vx rather than shifting Vx in place
+#define QUIRK_LOAD_ADVANCE  0x02    // FX55/FX65 leave I at I + X + 1
+#define QUIRK_LOAD_ADVANCE_X 0x04   // FX55/FX65 leave I at I + X
+#define QUIRK_JUMP_VX       0x08    // BXNN jumps to XNN + VX rather than NNN + V0
+#define QUIRK_WRAP_SPRITES  0x10    // DXYN wraps sprites round the screen edges rather than clipping
+
+#define QUIRK_MASK_MODERN   0
+#define QUIRK_MASK_VIP      (QUIRK_SHIFT_VY | QUIRK_LOAD_ADVANCE)
+#define QUIRK_MASK_CHIP48   (QUIRK_LOAD_ADVANCE_X | QUIRK_JUMP_VX)
+#define QUIRK_MASK_SCHIP    QUIRK_JUMP_VX
+#define QUIRK_MASK_XOCHIP   (QUIRK_SHIFT_VY | QUIRK_LOAD_ADVANCE | QUIRK_WRAP_SPRITES)
+
+// Code that depends on quirks is written once in a template header and included
+// once per profile with QUIRK_PROFILE set to the profile's name. QUIRKED names
+// that copy's functions and QUIRK_MASK is its constant set of quirks, so every
+// quirk test folds away at compile time
+#define QUIRK_PASTE(a, b) a##b
+#define QUIRK_CAT(a, b) QUIRK_PASTE(a, b)
+#define QUIRKED(name) QUIRK_CAT(name##_, QUIRK_PROFILE)
+#define QUIRK_MASK QUIRK_CAT(QUIRK_MASK_, QUIRK_PROFILE)
+
+// Call the copy of name specialized for cpu's profile. Run loops use it once per
+// call and then stay inside one copy. The plain executors built on it switch on
+// every instruction, so they are for callers outside the engines' hot paths
+#define QUIRK_SELECT(cpu, name, args)                                   \
+    do                                                                  \
+    {                                                                   \
+        switch((cpu)->quirks)                                           \
+        {                                                               \
+            case QUIRKS_VIP:    name##_VIP args;    break;              \
+            case QUIRKS_CHIP48: name##_CHIP48 args; break;              \
+            case QUIRKS_SCHIP:  name##_SCHIP args;  break;              \
+            case QUIRKS_XOCHIP: name##_XOCHIP args; break;              \
+            default:            name##_MODERN args; break;              \
+        }                                                               \
+    } while(0)
+
+// The quirk-dependent executors and switch interpreter, one copy per profile,
+// defined in chip8core.c through quirkexec.h
+#define DECLARE_QUIRKED(profile)                                        \
+    void Execute8XY6_##profile(CHIP8 *cpu, WORD inst);                  \
+    void Execute8XYE_##profile(CHIP8 *cpu, WORD inst);                  \
+    void ExecuteBNNN_##profile(CHIP8 *cpu, WORD inst);                  \
+    void ExecuteDXYN_##profile(CHIP8 *cpu, WORD inst);                  \
+    void ExecuteFX55_##profile(CHIP8 *cpu, WORD inst);                  \
+    void ExecuteFX65_##profile(CHIP8 *cpu, WORD inst);                  \
+    void DecodeExecute_##profile(CHIP8 *cpu, WORD inst);                \
+    void RunCyclesSwitch_##profile(CHIP8 *cpu, unsigned long count);
+
+DECLARE_QUIRKED(MODERN)
+DECLARE_QUIRKED(VIP)
+DECLARE_QUIRKED(CHIP48)
+DECLARE_QUIRKED(SCHIP)
+DECLARE_QUIRKED(XOCHIP)
+
+// The copy of DecodeExecute for a profile, for engines that look it up once per
+// run and then interpret single instructions through it
+typedef void (*DecodeFunction)(CHIP8 *cpu, WORD inst);
+DecodeFunction SelectDecodeExecute(QuirkProfile quirks);
+
+#endif
@@ -0,0 +1,194 @@
+#include <stdlib.h>
+#include <string.h>
+#include "rewind.h"
+
+// Control bytes of an encoded delta. A zero run skips bytes that did not change,
+// a literal run is followed by that many XOR bytes. Trailing unchanged bytes are
+// not encoded at all
+#define MAX_RUN 128
+#define LITERAL_FLAG 0x80
+
+// Bytes a record adds around its delta
+#define RECORD_OVERHEAD 4
+
+// Run-length encode the XOR of the keyframe and state, and make state the new
+// keyframe in the same pass. Returns the length of the delta
+static size_t EncodeDelta(BYTE *keyframe, const BYTE *state, BYTE *delta)
+{
+    size_t length = 0;
+    size_t i = 0;
+
+    while(i < SAVE_STATE_SIZE)
+    {
+        size_t start = i;
+
+        if(keyframe[i] == state[i])
+        {
+            // Most of a frame is unchanged, so step over it a word at a time
+            while(i + 8 <= SAVE_STATE_SIZE && i - start + 8 <= MAX_RUN && memcmp(&keyframe[i], &state[i], 8) == 0)
+                i += 8;
+            while(i < SAVE_STATE_SIZE && i - start < MAX_RUN && keyframe[i] == state[i])
+                ++i;
+            if(i < SAVE_STATE_SIZE)
+                delta[length++] = i - start - 1;
+        }
+        else
+        {
+            size_t control = length++;
+
+            while(i < SAVE_STATE_SIZE && i - start < MAX_RUN && keyframe[i] != state[i])
+            {
+                delta[length++] = keyframe[i] ^ state[i];
+                keyframe[i] = state[i];
+                ++i;
+            }
+            delta[control] = LITERAL_FLAG | (i - start - 1);
+        }
+    }
+
+    return length;
+}
+
+// XOR a delta into state, which steps it to the neighbouring frame
+static void ApplyDelta(BYTE *state, const BYTE *delta, size_t length)
+{
+    size_t i = 0;
+    size_t at = 0;
+
+    while(i < length)
+    {
+        BYTE control = delta[i++];
+        size_t run = (control & ~LITERAL_FLAG) + 1;
+
+        if(control & LITERAL_FLAG)
+        {
+            while(run-- > 0)
+                state[at++] ^= delta[i++];
+        }
+        else
+            at += run;
+    }
+}
+
+// Copy in and out of the ring, wrapping at its end
+static void RingWrite(Rewind *rewind, size_t offset, const BYTE *data, size_t length)
+{
+    size_t first;
+
+    offset %= rewind->capacity;
+    first = length < rewind->capacity - offset ? length : rewind->capacity - offset;
+    memcpy(&rewind->ring[offset], data, first);
+    memcpy(rewind->ring, &data[first], length - first);
+}
+
+static void RingRead(const Rewind *rewind, size_t offset, BYTE *data, size_t length)
+{
+    size_t first;
+
+    offset %= rewind->capacity;
+    first = length < rewind->capacity - offset ? length : rewind->capacity - offset;
+    memcpy(data, &rewind->ring[offset], first);
+    memcpy(&data[first], rewind->ring, length - first);
+}
+
+static size_t RingReadLength(const Rewind *rewind, size_t offset)
+{
+    BYTE length[2];
+
+    RingRead(rewind, offset, length, 2);
+    return length[0] | length[1] << 8;
+}
+
+Rewind *CreateRewind(size_t budget)
+{
+    Rewind *rewind = calloc(1, sizeof(Rewind));
+
+    if(rewind == NULL)
+        return NULL;
+
+    rewind->capacity = budget > 0 ? budget : 1;
+    rewind->ring = malloc(rewind->capacity);
+    if(rewind->ring == NULL)
+    {
+        free(rewind);
+        return NULL;
+    }
+
+    return rewind;
+}
+
+void DestroyRewind(Rewind *rewind)
+{
+    if(rewind == NULL)
+        return;
+    free(rewind->ring);
+    free(rewind);
+}
+
+void ClearRewind(Rewind *rewind)
+{
+    rewind->oldest = 0;
+    rewind->used = 0;
+    rewind->frames = 0;
+    rewind->hasKeyframe = 0;
+}
+
+void CaptureFrame(Rewind *rewind, const CHIP8 *cpu)
+{
+    BYTE state[SAVE_STATE_SIZE];
+    BYTE *record = rewind->scratch;
+    size_t length, total;
+
+    SaveState(cpu, state);
+    if(!rewind->hasKeyframe)
+    {
+        memcpy(rewind->keyframe, state, SAVE_STATE_SIZE);
+        rewind->hasKeyframe = 1;
+        return;
+    }
+
+    length = EncodeDelta(rewind->keyframe, state, &record[2]);
+    total = length + RECORD_OVERHEAD;
+    record[0] = record[length + 2] = length & 0xFF;
+    record[1] = record[length + 3] = length >> 8;
+
+    // A budget too small for even one record keeps no history at all
+    if(total > rewind->capacity)
+    {
+        rewind->oldest = rewind->used = rewind->frames = 0;
+        return;
+    }
+
+    // Make room by forgetting the oldest frames
+    while(rewind->capacity - rewind->used < total)
+    {
+        size_t oldest = RingReadLength(rewind, rewind->oldest) + RECORD_OVERHEAD;
+
+        rewind->oldest = (rewind->oldest + oldest) % rewind->capacity;
+        rewind->used -= oldest;
+        --rewind->frames;
+    }
+
+    RingWrite(rewind, rewind->oldest + rewind->used, record, total);
+    rewind->used += total;
+    ++rewind->frames;
+}
+
+int RewindFrame(Rewind *rewind, CHIP8 *cpu)
+{
+    size_t end, length;
+
+    if(rewind->frames == 0)
+        return -1;
+
+    // The newest record ends with its length
+    end = rewind->oldest + rewind->used;
+    length = RingReadLength(rewind, end + rewind->capacity - 2);
+    RingRead(rewind, end + rewind->capacity - 2 - length, rewind->scratch, length);
+
+    ApplyDelta(rewind->keyframe, rewind->scratch, length);
+    rewind->used -= length + RECORD_OVERHEAD;
+    --rewind->frames;
+
+    return LoadState(cpu, rewind->keyframe, SAVE_STATE_SIZE);
+}
@@ -0,0 +1,45 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <stddef.h>
+#include "chip8core.h"
+#include "savestate.h"
+
+// Frame history for stepping a machine backwards. The newest captured frame is
+// kept whole as the keyframe, and every older frame is a record holding the
+// XOR of it and the frame after it, run-length encoded. Most frames touch a
+// handful of bytes, so records are usually a few dozen bytes
+//
+// Records live back to back in a fixed-size ring as
+// [length, 2 bytes][delta][length, 2 bytes] so they can be popped from the
+// newest end and evicted from the oldest end
+typedef struct Rewind
+{
+    BYTE *ring;
+    size_t capacity;    // Bytes in ring, the memory budget for history
+    size_t oldest;      // Offset of the oldest record
+    size_t used;        // Bytes of ring holding records
+    unsigned long frames;   // Records held, i.e. how many frames back we can go
+
+    BYTE keyframe[SAVE_STATE_SIZE]; // Newest captured frame
+    BYTE hasKeyframe;
+
+    BYTE scratch[SAVE_STATE_SIZE * 2];  // Encoding space, larger than any record
+} Rewind;
+
+// budget is the number of bytes history may use. Returns NULL if it can't be allocated
+Rewind *CreateRewind(size_t budget);
+void DestroyRewind(Rewind *rewind);
+
+// Record the machine as it is now. Call once per frame. When the budget is full
+// the oldest frames are forgotten
+void CaptureFrame(Rewind *rewind, const CHIP8 *cpu);
+
+// Put the machine back to the frame captured before the newest one, which
+// becomes the newest. Returns non-zero when there is no older frame
+int RewindFrame(Rewind *rewind, CHIP8 *cpu);
+
+// Forget all history, e.g. after loading a save state
+void ClearRewind(Rewind *rewind);
+
+#endif
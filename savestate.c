@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <string.h>
+#include "savestate.h"
+
+// Field offsets, see the layout in savestate.h
+#define OFFSET_VERSION 4
+#define OFFSET_MEMORY 8
+#define OFFSET_REGISTERS (OFFSET_MEMORY + MEMORY_SIZE)
+#define OFFSET_KEYS (OFFSET_REGISTERS + NUM_REGISTERS)
+#define OFFSET_TIMERS (OFFSET_KEYS + NUM_KEYS)
+#define OFFSET_POINTERS (OFFSET_TIMERS + 2)
+#define OFFSET_SCREEN (OFFSET_POINTERS + 6)
+#define OFFSET_RANDOM (OFFSET_SCREEN + 2 * HIRES_HEIGHT * 8)
+#define OFFSET_HIRES (OFFSET_RANDOM + 8)
+#define OFFSET_FLAGS (OFFSET_HIRES + 1)
+#define OFFSET_QUIRKS (OFFSET_FLAGS + NUM_USER_FLAGS)
+
+// Where each version keeps the fields that moved or were added since version 1.
+// An offset of zero marks a field the version lacks
+typedef struct Layout
+{
+    WORD version;
+    size_t size;
+    int screenWords;
+    size_t random;
+    size_t hires;
+    size_t flags;
+    size_t quirks;
+} Layout;
+
+static const Layout LAYOUTS[] =
+{
+    { 1, 4400, SCREEN_HEIGHT, 0, 0, 0, 0 },
+    { 2, 4408, SCREEN_HEIGHT, 4400, 0, 0, 0 },
+    { 3, 5193, 2 * HIRES_HEIGHT, OFFSET_RANDOM, OFFSET_HIRES, OFFSET_FLAGS, 0 },
+    { SAVE_STATE_VERSION, SAVE_STATE_SIZE, 2 * HIRES_HEIGHT, OFFSET_RANDOM, OFFSET_HIRES, OFFSET_FLAGS, OFFSET_QUIRKS }
+};
+
+static void PutWord(BYTE *buffer, WORD value)
+{
+    buffer[0] = value & 0xFF;
+    buffer[1] = value >> 8;
+}
+
+static WORD GetWord(const BYTE *buffer)
+{
+    return buffer[0] | buffer[1] << 8;
+}
+
+void SaveState(const CHIP8 *cpu, BYTE *buffer)
+{
+    int i, j;
+
+    memcpy(buffer, SAVE_STATE_MAGIC, 4);
+    PutWord(&buffer[OFFSET_VERSION], SAVE_STATE_VERSION);
+    PutWord(&buffer[OFFSET_VERSION + 2], 0);
+
+    memcpy(&buffer[OFFSET_MEMORY], cpu->mainMemory, MEMORY_SIZE);
+    memcpy(&buffer[OFFSET_REGISTERS], cpu->dataRegisters, NUM_REGISTERS);
+    memcpy(&buffer[OFFSET_KEYS], cpu->inputKeys, NUM_KEYS);
+
+    buffer[OFFSET_TIMERS] = cpu->regDT;
+    buffer[OFFSET_TIMERS + 1] = cpu->regST;
+    PutWord(&buffer[OFFSET_POINTERS], cpu->regI);
+    PutWord(&buffer[OFFSET_POINTERS + 2], cpu->PC);
+    PutWord(&buffer[OFFSET_POINTERS + 4], cpu->SP);
+
+    for(i = 0; i < 2 * HIRES_HEIGHT; ++i)
+    {
+        for(j = 0; j < 8; ++j)
+            buffer[OFFSET_SCREEN + i * 8 + j] = cpu->screenRows[i] >> (j * 8);
+    }
+
+    for(j = 0; j < 8; ++j)
+        buffer[OFFSET_RANDOM + j] = cpu->rngState >> (j * 8);
+
+    buffer[OFFSET_HIRES] = cpu->hires;
+    memcpy(&buffer[OFFSET_FLAGS], cpu->userFlags, NUM_USER_FLAGS);
+    buffer[OFFSET_QUIRKS] = cpu->quirks;
+}
+
+int LoadState(CHIP8 *cpu, const BYTE *buffer, size_t size)
+{
+    const Layout *layout = NULL;
+    int i, j;
+
+    if(size < OFFSET_MEMORY || memcmp(buffer, SAVE_STATE_MAGIC, 4) != 0)
+        return -1;
+    for(i = 0; i < (int)(sizeof(LAYOUTS) / sizeof(LAYOUTS[0])); ++i)
+    {
+        if(GetWord(&buffer[OFFSET_VERSION]) == LAYOUTS[i].version && size == LAYOUTS[i].size)
+            layout = &LAYOUTS[i];
+    }
+    if(layout == NULL || (layout->quirks != 0 && buffer[layout->quirks] > QUIRKS_XOCHIP))
+        return -1;
+
+    // Only changed bytes are stored, so decoded instructions that survive the
+    // restore are kept
+    WriteMemory(cpu, 0, &buffer[OFFSET_MEMORY], MEMORY_SIZE);
+    memcpy(cpu->dataRegisters, &buffer[OFFSET_REGISTERS], NUM_REGISTERS);
+    memcpy(cpu->inputKeys, &buffer[OFFSET_KEYS], NUM_KEYS);
+
+    cpu->regDT = buffer[OFFSET_TIMERS];
+    cpu->regST = buffer[OFFSET_TIMERS + 1];
+    cpu->regI = GetWord(&buffer[OFFSET_POINTERS]);
+    // A hand-edited or corrupt state can't point outside memory
+    cpu->PC = GetWord(&buffer[OFFSET_POINTERS + 2]) & ADDRESS_MASK;
+    cpu->SP = GetWord(&buffer[OFFSET_POINTERS + 4]) & ADDRESS_MASK;
+
+    // Words a low resolution screen doesn't use must stay zero, whatever the blob says
+    cpu->hires = layout->hires != 0 && buffer[layout->hires] != 0;
+    for(i = 0; i < 2 * HIRES_HEIGHT; ++i)
+    {
+        cpu->screenRows[i] = 0;
+        for(j = 0; j < 8 && i < SCREEN_WORDS(cpu) && i < layout->screenWords; ++j)
+            cpu->screenRows[i] |= (uint64_t)buffer[OFFSET_SCREEN + i * 8 + j] << (j * 8);
+    }
+
+    if(layout->random != 0)
+    {
+        cpu->rngState = 0;
+        for(j = 0; j < 8; ++j)
+            cpu->rngState |= (uint64_t)buffer[layout->random + j] << (j * 8);
+    }
+
+    if(layout->flags != 0)
+        memcpy(cpu->userFlags, &buffer[layout->flags], NUM_USER_FLAGS);
+    else
+        memset(cpu->userFlags, 0, NUM_USER_FLAGS);
+    if(layout->quirks != 0)
+        cpu->quirks = buffer[layout->quirks];
+
+    // Whatever was on screen before is stale, and the machine jumped, so any
+    // busy-wait loop seen so far proves nothing
+    cpu->screenDirty = 1;
+    ++cpu->writeCount;
+    cpu->idle.target = 0xFFFF;
+
+    return 0;
+}
+
+int SaveStateFile(const CHIP8 *cpu, const char *path)
+{
+    BYTE buffer[SAVE_STATE_SIZE];
+    FILE *output;
+    int result;
+
+    if((output = fopen(path, "wb")) == NULL)
+        return -1;
+
+    SaveState(cpu, buffer);
+    result = fwrite(buffer, SAVE_STATE_SIZE, 1, output) == 1 ? 0 : -1;
+    if(fclose(output) != 0)
+        result = -1;
+
+    return result;
+}
+
+int LoadStateFile(CHIP8 *cpu, const char *path)
+{
+    BYTE buffer[SAVE_STATE_SIZE + 1];
+    FILE *input;
+    size_t size;
+
+    if((input = fopen(path, "rb")) == NULL)
+        return -1;
+
+    // Read one byte extra so oversized files are caught by the size check
+    size = fread(buffer, 1, sizeof(buffer), input);
+    fclose(input);
+
+    return LoadState(cpu, buffer, size);
+}
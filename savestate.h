@@ -0,0 +1,49 @@
+#ifndef SAVESTATE_H
+#define SAVESTATE_H
+
+#include <stddef.h>
+#include "chip8core.h"
+
+// Save states are one fixed-layout blob, little-endian throughout:
+//
+//   offset  size  field
+//        0     4  "C8SS"
+//        4     2  version
+//        6     2  reserved, zero
+//        8  4096  mainMemory, which includes the stack
+//     4104    16  dataRegisters
+//     4120    16  inputKeys
+//     4136     1  regDT
+//     4137     1  regST
+//     4138     2  regI
+//     4140     2  PC
+//     4142     2  SP
+//     4144  1024  screenRows, all 128 words of 8 bytes
+//     5168     8  rngState
+//     5176     1  hires
+//     5177    16  userFlags
+//     5193     1  quirks
+//
+// Any change to the layout must bump SAVE_STATE_VERSION. Older versions still
+// load: version 1 ended after screenRows, which held 32 words, and version 2
+// added rngState after them at 4400. Both are low resolution with clear user
+// flags, and a version 1 state leaves the random state as it was. Version 3
+// ended before quirks, and like the others leaves the machine's profile alone
+#define SAVE_STATE_MAGIC "C8SS"
+#define SAVE_STATE_VERSION 4
+#define SAVE_STATE_SIZE 5194
+
+// Write the machine into buffer, which must hold SAVE_STATE_SIZE bytes
+void SaveState(const CHIP8 *cpu, BYTE *buffer);
+
+// Restore the machine from a blob, quirks included. Engine and host-side
+// settings are kept.
+// Returns non-zero, leaving the machine untouched, if the blob is not a save
+// state of any version
+int LoadState(CHIP8 *cpu, const BYTE *buffer, size_t size);
+
+// The same through a file. Return non-zero on I/O errors or a bad blob
+int SaveStateFile(const CHIP8 *cpu, const char *path);
+int LoadStateFile(CHIP8 *cpu, const char *path);
+
+#endif
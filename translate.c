@@ -0,0 +1,431 @@
+#include <stdio.h>
+#include <string.h>
+#include "chip8core.h"
+#include "quirks.h"
+
+// Longest run of instructions translated as one block
+#define MAX_BLOCK 64
+
+// Suffixes of the core's per-profile executors, in QuirkProfile order
+static const char *profileNames[QUIRK_PROFILES] = { "MODERN", "VIP", "CHIP48", "SCHIP", "XOCHIP" };
+
+// How an instruction leaves control, which decides where blocks end and which
+// addresses the walk goes on to
+typedef enum Flow
+{
+    FLOW_NEXT,      // Falls through
+    FLOW_STORE,     // Falls through, but may have rewritten code after it
+    FLOW_JUMP,      // 1NNN
+    FLOW_CALL,      // 2NNN, which comes back to the next instruction
+    FLOW_RETURN,    // 00EE, whose targets come from the calls
+    FLOW_SKIP,      // Goes to the next instruction or the one after
+    FLOW_WAIT,      // FX0A, which repeats itself until a key is down
+    FLOW_EXIT,      // 00FD, which repeats itself forever
+    FLOW_COMPUTED   // BNNN, only known at run time
+} Flow;
+
+// Addresses reached but not yet translated, and every address ever reached
+typedef struct Walk
+{
+    WORD pending[MEMORY_SIZE];
+    int count;
+    BYTE reached[MEMORY_SIZE];
+} Walk;
+
+// Mirrors the decoding in DecodeExecute, including which opcodes do nothing
+static Flow GetFlow(WORD inst)
+{
+    switch(inst & 0xF000)
+    {
+        case 0x0000:
+            if(inst == 0x00EE)
+                return FLOW_RETURN;
+            return inst == 0x00FD ? FLOW_EXIT : FLOW_NEXT;
+        case 0x1000: return FLOW_JUMP;
+        case 0x2000: return FLOW_CALL;
+        case 0x3000:
+        case 0x4000:
+        case 0x5000:
+        case 0x9000: return FLOW_SKIP;
+        case 0xB000: return FLOW_COMPUTED;
+        case 0xE000: return (inst & 0x00FF) == 0x9E || (inst & 0x00FF) == 0xA1 ? FLOW_SKIP : FLOW_NEXT;
+        case 0xF000:
+            switch(inst & 0x00FF)
+            {
+                case 0x0A: return FLOW_WAIT;
+                case 0x33:
+                case 0x55: return FLOW_STORE;
+                default: return FLOW_NEXT;
+            }
+        default: return FLOW_NEXT;
+    }
+}
+
+static void Reach(Walk *walk, WORD addr)
+{
+    addr &= ADDRESS_MASK;
+    if(!walk->reached[addr])
+    {
+        walk->reached[addr] = 1;
+        walk->pending[walk->count++] = addr;
+    }
+}
+
+// Instructions in the block starting at start. Zero if not even one fits
+static int MeasureBlock(const BYTE *memory, WORD start, Flow *last)
+{
+    WORD addr = start;
+    int count = 0;
+
+    *last = FLOW_NEXT;
+    while(count < MAX_BLOCK && addr < MEMORY_SIZE - 1)
+    {
+        *last = GetFlow(memory[addr] << 8 | memory[addr + 1]);
+        ++count;
+        addr += 2;
+        if(*last != FLOW_NEXT)
+            break;
+    }
+
+    return count;
+}
+
+// Non-zero if inst reads or writes V registers in the code EmitInstruction writes
+static int UsesRegisters(WORD inst)
+{
+    switch(inst & 0xF000)
+    {
+        case 0x3000: case 0x4000: case 0x6000: case 0x7000:
+            return 1;
+        case 0x5000: case 0x9000:
+            return (inst & 0x0F00) >> 8 != (inst & 0x00F0) >> 4;
+        case 0x8000:
+            return (inst & 0x000F) <= 0x5 || (inst & 0x000F) == 0x7;
+        case 0xE000:
+            return (inst & 0x00FF) == 0x9E || (inst & 0x00FF) == 0xA1;
+        case 0xF000:
+            return (inst & 0x00FF) == 0x07 || (inst & 0x00FF) == 0x15 ||
+                   (inst & 0x00FF) == 0x18 || (inst & 0x00FF) == 0x1E;
+        default:
+            return 0;
+    }
+}
+
+// Non-zero if inst behaves differently between quirk profiles
+static int DependsOnQuirks(WORD inst)
+{
+    switch(inst & 0xF000)
+    {
+        case 0x8000:
+            return (inst & 0x000F) == 0x6 || (inst & 0x000F) == 0xE;
+        case 0xB000:
+        case 0xD000:
+            return 1;
+        case 0xF000:
+            return (inst & 0x00FF) == 0x55 || (inst & 0x00FF) == 0x65;
+        default:
+            return 0;
+    }
+}
+
+// C for one instruction, behaving exactly as its core executor. Simple ones are
+// written out so the compiler can keep registers across them, and anything
+// with side effects beyond the registers calls the core. Quirk-dependent ones
+// call the copy of their executor for profile, so nothing switches at run time
+static void EmitInstruction(FILE *output, WORD addr, WORD inst, const char *profile)
+{
+    int x = (inst & 0x0F00) >> 8;
+    int y = (inst & 0x00F0) >> 4;
+    int nn = inst & 0x00FF;
+    int nnn = inst & 0x0FFF;
+    WORD next = (addr + 2) & ADDRESS_MASK;
+    WORD skip = (addr + 4) & ADDRESS_MASK;
+    char line[128];
+
+    line[0] = '\0';
+    switch(inst & 0xF000)
+    {
+        case 0x0000:
+            if(inst == 0x00E0)
+                sprintf(line, "Execute00E0(cpu);");
+            else if(inst == 0x00EE)
+                sprintf(line, "Execute00EE(cpu);");
+            else if(inst == 0x00FB)
+                sprintf(line, "Execute00FB(cpu);");
+            else if(inst == 0x00FC)
+                sprintf(line, "Execute00FC(cpu);");
+            else if(inst == 0x00FD)
+                sprintf(line, "cpu->PC = 0x%03X;", addr);
+            else if(inst == 0x00FE)
+                sprintf(line, "Execute00FE(cpu);");
+            else if(inst == 0x00FF)
+                sprintf(line, "Execute00FF(cpu);");
+            else if((inst & 0xFFF0) == 0x00C0)
+                sprintf(line, "Execute00CN(cpu, 0x%04X);", inst);
+            break;
+        case 0x1000:
+            sprintf(line, "cpu->PC = 0x%03X;", nnn);
+            break;
+        case 0x2000:
+            sprintf(line, "cpu->PC = 0x%03X; Execute2NNN(cpu, 0x%04X);", next, inst);
+            break;
+        case 0x3000:
+            sprintf(line, "cpu->PC = v[0x%X] == 0x%02X ? 0x%03X : 0x%03X;", x, nn, skip, next);
+            break;
+        case 0x4000:
+            sprintf(line, "cpu->PC = v[0x%X] != 0x%02X ? 0x%03X : 0x%03X;", x, nn, skip, next);
+            break;
+        case 0x5000:
+            // Comparing a register with itself would draw warnings from the
+            // compiler building the output, and its result is known anyway
+            if(x == y)
+                sprintf(line, "cpu->PC = 0x%03X;", skip);
+            else
+                sprintf(line, "cpu->PC = v[0x%X] == v[0x%X] ? 0x%03X : 0x%03X;", x, y, skip, next);
+            break;
+        case 0x6000:
+            sprintf(line, "v[0x%X] = 0x%02X;", x, nn);
+            break;
+        case 0x7000:
+            sprintf(line, "v[0x%X] += 0x%02X;", x, nn);
+            break;
+        case 0x8000:
+            // VF is written before Vx, exactly as in the core executors
+            switch(inst & 0x000F)
+            {
+                case 0x0: sprintf(line, "v[0x%X] = v[0x%X];", x, y); break;
+                case 0x1: sprintf(line, "v[0x%X] |= v[0x%X];", x, y); break;
+                case 0x2: sprintf(line, "v[0x%X] &= v[0x%X];", x, y); break;
+                case 0x3: sprintf(line, "v[0x%X] ^= v[0x%X];", x, y); break;
+                case 0x4: sprintf(line, "v[0xF] = v[0x%X] + v[0x%X] > 0xFF; v[0x%X] += v[0x%X];", x, y, x, y); break;
+                case 0x5: sprintf(line, "v[0xF] = v[0x%X] > v[0x%X]; v[0x%X] = v[0x%X] - v[0x%X];", x, y, x, x, y); break;
+                case 0x6: sprintf(line, "Execute8XY6_%s(cpu, 0x%04X);", profile, inst); break;
+                case 0x7: sprintf(line, "v[0xF] = v[0x%X] > v[0x%X]; v[0x%X] = v[0x%X] - v[0x%X];", y, x, x, y, x); break;
+                case 0xE: sprintf(line, "Execute8XYE_%s(cpu, 0x%04X);", profile, inst); break;
+                default: break;
+            }
+            break;
+        case 0x9000:
+            // As for 5XY0
+            if(x == y)
+                sprintf(line, "cpu->PC = 0x%03X;", next);
+            else
+                sprintf(line, "cpu->PC = v[0x%X] != v[0x%X] ? 0x%03X : 0x%03X;", x, y, skip, next);
+            break;
+        case 0xA000:
+            sprintf(line, "cpu->regI = 0x%03X;", nnn);
+            break;
+        case 0xB000:
+            sprintf(line, "ExecuteBNNN_%s(cpu, 0x%04X);", profile, inst);
+            break;
+        case 0xC000:
+            sprintf(line, "ExecuteCXNN(cpu, 0x%04X);", inst);
+            break;
+        case 0xD000:
+            sprintf(line, "ExecuteDXYN_%s(cpu, 0x%04X);", profile, inst);
+            break;
+        case 0xE000:
+            if(nn == 0x9E)
+                sprintf(line, "cpu->PC = cpu->inputKeys[v[0x%X] & 0xF] == 0xFF ? 0x%03X : 0x%03X;", x, skip, next);
+            else if(nn == 0xA1)
+                sprintf(line, "cpu->PC = cpu->inputKeys[v[0x%X] & 0xF] == 0x00 ? 0x%03X : 0x%03X;", x, skip, next);
+            break;
+        case 0xF000:
+            switch(nn)
+            {
+                case 0x07: sprintf(line, "v[0x%X] = cpu->regDT;", x); break;
+                case 0x0A: sprintf(line, "cpu->PC = 0x%03X; ExecuteFX0A(cpu, 0x%04X);", next, inst); break;
+                case 0x15: sprintf(line, "cpu->regDT = v[0x%X];", x); break;
+                case 0x18: sprintf(line, "cpu->regST = v[0x%X];", x); break;
+                case 0x1E: sprintf(line, "cpu->regI += v[0x%X];", x); break;
+                case 0x29: sprintf(line, "ExecuteFX29(cpu, 0x%04X);", inst); break;
+                case 0x30: sprintf(line, "ExecuteFX30(cpu, 0x%04X);", inst); break;
+                case 0x33: sprintf(line, "ExecuteFX33(cpu, 0x%04X);", inst); break;
+                case 0x55: sprintf(line, "ExecuteFX55_%s(cpu, 0x%04X);", profile, inst); break;
+                case 0x65: sprintf(line, "ExecuteFX65_%s(cpu, 0x%04X);", profile, inst); break;
+                case 0x75: sprintf(line, "ExecuteFX75(cpu, 0x%04X);", inst); break;
+                case 0x85: sprintf(line, "ExecuteFX85(cpu, 0x%04X);", inst); break;
+                default: break;
+            }
+            break;
+    }
+
+    // Opcodes the core ignores still take a cycle, so they keep a line
+    fprintf(output, "    %-72s// %03X: %04X\n", line[0] != '\0' ? line : ";", addr, inst);
+}
+
+// Non-zero if any instruction in the block depends on quirks, in which case it
+// is emitted once per profile
+static int BlockDependsOnQuirks(const BYTE *memory, WORD start, int count)
+{
+    int i;
+
+    for(i = 0; i < count; ++i)
+    {
+        if(DependsOnQuirks(memory[start + 2 * i] << 8 | memory[start + 2 * i + 1]))
+            return 1;
+    }
+
+    return 0;
+}
+
+// Name of the function for the block at start under profile. Blocks that do
+// not depend on quirks are shared by every profile
+static const char *BlockName(char *name, const BYTE *memory, WORD start, int count, int quirks)
+{
+    if(BlockDependsOnQuirks(memory, start, count))
+        sprintf(name, "Block%03X_%s", start, profileNames[quirks]);
+    else
+        sprintf(name, "Block%03X", start);
+
+    return name;
+}
+
+static void EmitBlock(FILE *output, const BYTE *memory, WORD start, int count, Flow last, int quirks)
+{
+    WORD addr;
+    char name[32];
+    int i, registers = 0;
+
+    for(i = 0; i < count; ++i)
+        registers |= UsesRegisters(memory[start + 2 * i] << 8 | memory[start + 2 * i + 1]);
+
+    fprintf(output, "static void %s(CHIP8 *cpu)\n{\n", BlockName(name, memory, start, count, quirks));
+    if(registers)
+        fprintf(output, "    BYTE *v = cpu->dataRegisters;\n\n");
+
+    for(i = 0, addr = start; i < count; ++i, addr += 2)
+        EmitInstruction(output, addr, memory[addr] << 8 | memory[addr + 1], profileNames[quirks]);
+
+    // Blocks cut short by a store or the length limit carry on from the next
+    // instruction. Everything else has set PC itself
+    if(last == FLOW_NEXT || last == FLOW_STORE)
+        fprintf(output, "    cpu->PC = 0x%03X;\n", addr & ADDRESS_MASK);
+    fprintf(output, "}\n\n");
+}
+
+int main(int argc, char **argv)
+{
+    static CHIP8 cpu;
+    static Walk walk;
+    static int counts[MEMORY_SIZE];
+    FILE *input, *output;
+    size_t size;
+    char name[32];
+    int i, quirks, blocks = 0;
+
+    if(argc != 3)
+    {
+        fprintf(stderr, "USAGE ERROR!\nCorrect Usage: chip8-translate <rom-file> <output.c>.");
+        return -1;
+    }
+
+    // Memory exactly as the frontend sets it up, so blocks match at run time
+    if((input = fopen(argv[1], "rb")) == NULL)
+    {
+        fprintf(stderr, "FILE I/O ERROR!\nCould not open file \"%s\".", argv[1]);
+        return -1;
+    }
+    size = fread(&cpu.mainMemory[PROGRAM_START], 1, MAX_ROM_SIZE + 1, input);
+    fclose(input);
+    if(size > MAX_ROM_SIZE)
+    {
+        fprintf(stderr, "FILE I/O ERROR!\n\"%s\" is too large to be a chip8 ROM.", argv[1]);
+        return -1;
+    }
+    InitializeCPU(&cpu);
+
+    // Follow every path from the entry point. Anything the walk misses, such
+    // as BNNN targets, is left to the interpreter at run time
+    Reach(&walk, PROGRAM_START);
+    while(walk.count > 0)
+    {
+        WORD start = walk.pending[--walk.count];
+        WORD end;
+        Flow last;
+        int count = MeasureBlock(cpu.mainMemory, start, &last);
+
+        if(count == 0)
+            continue;
+        counts[start] = count;
+        ++blocks;
+
+        end = start + 2 * (count - 1);
+        switch(last)
+        {
+            case FLOW_JUMP:
+                Reach(&walk, (cpu.mainMemory[end] << 8 | cpu.mainMemory[end + 1]) & 0x0FFF);
+                break;
+            case FLOW_CALL:
+                Reach(&walk, (cpu.mainMemory[end] << 8 | cpu.mainMemory[end + 1]) & 0x0FFF);
+                Reach(&walk, end + 2);
+                break;
+            case FLOW_SKIP:
+                Reach(&walk, end + 2);
+                Reach(&walk, end + 4);
+                break;
+            case FLOW_WAIT:
+                Reach(&walk, end);
+                Reach(&walk, end + 2);
+                break;
+            case FLOW_EXIT:
+                Reach(&walk, end);
+                break;
+            case FLOW_NEXT:
+            case FLOW_STORE:
+                Reach(&walk, end + 2);
+                break;
+            default:
+                break;
+        }
+    }
+
+    if((output = fopen(argv[2], "w")) == NULL)
+    {
+        fprintf(stderr, "FILE I/O ERROR!\nCould not open file \"%s\".", argv[2]);
+        return -1;
+    }
+
+    fprintf(output, "// Translated from %s by chip8-translate. Do not edit\n#include \"aot.h\"\n#include \"quirks.h\"\n\n", argv[1]);
+    for(i = 0; i < MEMORY_SIZE; ++i)
+    {
+        if(counts[i] > 0)
+        {
+            Flow last;
+            MeasureBlock(cpu.mainMemory, i, &last);
+            if(BlockDependsOnQuirks(cpu.mainMemory, i, counts[i]))
+            {
+                for(quirks = 0; quirks < QUIRK_PROFILES; ++quirks)
+                    EmitBlock(output, cpu.mainMemory, i, counts[i], last, quirks);
+            }
+            else
+                EmitBlock(output, cpu.mainMemory, i, counts[i], last, QUIRKS_MODERN);
+        }
+    }
+
+    fprintf(output, "const AOTProgram aotProgram =\n{\n    {\n");
+    for(quirks = 0; quirks < QUIRK_PROFILES; ++quirks)
+    {
+        fprintf(output, "        {   // %s\n", profileNames[quirks]);
+        for(i = 0; i < MEMORY_SIZE; ++i)
+        {
+            if(counts[i] > 0)
+                fprintf(output, "            [0x%03X] = { %s, %d },\n", i,
+                        BlockName(name, cpu.mainMemory, i, counts[i], quirks), counts[i]);
+        }
+        fprintf(output, "        },\n");
+    }
+    fprintf(output, "    },\n    {");
+    for(i = 0; i < MEMORY_SIZE; ++i)
+        fprintf(output, "%s0x%02X,", i % 16 == 0 ? "\n        " : " ", cpu.mainMemory[i]);
+    fprintf(output, "\n    }\n};\n");
+
+    if(fclose(output) != 0)
+    {
+        fprintf(stderr, "FILE I/O ERROR!\nCould not write \"%s\".", argv[2]);
+        return -1;
+    }
+
+    fprintf(stderr, "%d blocks translated from \"%s\"\n", blocks, argv[1]);
+    return 0;
+}